@@ -50,9 +50,22 @@ HEADERS  += src/repogui.h \
             src/workers/repo_workerfetchrevision.h \
             src/workers/repo_workerhistory.h \
             src/workers/repo_workerusers.h \
+            src/workers/repo_importscheduler.h \
+            src/workers/repo_batchimport.h \
             src/primitives/repo_sortfilterproxymodel.h \
             src/primitives/repo_glccamera.h \
+            src/primitives/repo_glcmesh.h \
+            src/primitives/repo_meshsimplifier.h \
+            src/primitives/repo_indexoptimizer.h \
+            src/primitives/repo_threadpool.h \
+            src/primitives/repo_memory.h \
+            src/primitives/repo_texturecache.h \
+            src/primitives/repo_meshindexcache.h \
+            src/primitives/repo_scenecache.h \
+            src/primitives/repo_documentcache.h \
             src/conversion/repo_transcoder_assimp.h \
+            src/conversion/repo_transcoder_kernels.h \
+            src/conversion/repo_transcoder_graph.h \
             src/oculus/repo_oculus.h \
             src/dialogs/repodialogoculus.h \
             src/dialogs/repodialogusermanager.h \
@@ -78,9 +91,22 @@ SOURCES += src/main.cpp\
            src/workers/repo_workerfetchrevision.cpp \
            src/workers/repo_workerhistory.cpp \
            src/workers/repo_workerusers.cpp \
+           src/workers/repo_importscheduler.cpp \
+           src/workers/repo_batchimport.cpp \
            src/primitives/repo_sortfilterproxymodel.cpp \
            src/primitives/repo_glccamera.cpp \
+           src/primitives/repo_glcmesh.cpp \
+           src/primitives/repo_meshsimplifier.cpp \
+           src/primitives/repo_indexoptimizer.cpp \
+           src/primitives/repo_threadpool.cpp \
+           src/primitives/repo_memory.cpp \
+           src/primitives/repo_texturecache.cpp \
+           src/primitives/repo_meshindexcache.cpp \
+           src/primitives/repo_scenecache.cpp \
+           src/primitives/repo_documentcache.cpp \
            src/conversion/repo_transcoder_assimp.cpp \
+           src/conversion/repo_transcoder_kernels.cpp \
+           src/conversion/repo_transcoder_graph.cpp \
            src/oculus/repo_oculus.cpp \
            src/dialogs/repodialogoculus.cpp \
            src/dialogs/repodialogusermanager.cpp \
@@ -96,6 +122,9 @@ FORMS    += forms/repogui.ui \
             forms/repodialoguser.ui
 
 
+# Process memory statistics
+win32:LIBS += -lpsapi
+
 # http://qt-project.org/doc/qt-5/resources.html
 RESOURCES += resources.qrc \
              submodules/fonts.qrc \
@@ -16,9 +16,40 @@
  */
 
 #include "repo_transcoder_assimp.h"
+#include <algorithm>
 #include <iostream>
+#include <cstring>
 #include <glc_factory.h>
 #include "../primitives/repo_glccamera.h"
+#include "../primitives/repo_glcmesh.h"
+#include "../primitives/repo_meshsimplifier.h"
+#include "../primitives/repo_threadpool.h"
+#include "../primitives/repo_memory.h"
+#include "../primitives/repo_texturecache.h"
+#include "repo_transcoder_kernels.h"
+#include <QAtomicInt>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSet>
+#include <QStringList>
+#include <QTime>
+
+//-----------------------------------------------------------------------------
+
+const QString repo::gui::RepoTranscoderAssimp::REPO_SETTINGS_TRANSCODER_THREADS =
+	"RepoTranscoderAssimp/threads";
+
+const QString repo::gui::RepoTranscoderAssimp::REPO_SETTINGS_TRANSCODER_LOD_ERRORS =
+	"RepoTranscoderAssimp/lodErrors";
+
+const QString repo::gui::RepoTranscoderAssimp::REPO_SETTINGS_TRANSCODER_OPTIMIZE_INDICES =
+	"RepoTranscoderAssimp/optimizeIndices";
+
+const QString repo::gui::RepoTranscoderAssimp::REPO_SETTINGS_TRANSCODER_COMPACT_ATTRIBUTES =
+	"RepoTranscoderAssimp/compactAttributes";
+
+//! Guards material usage bookkeeping shared by meshes converted in parallel.
+static QMutex glcMaterialsMutex;
 
 //-----------------------------------------------------------------------------
 //
@@ -28,32 +59,34 @@
 GLC_World repo::gui::RepoTranscoderAssimp::toGLCWorld(
 	const aiScene* assimpScene,
 	const std::map<std::string, QImage> &textures,
-	const std::string &namePrefix)
+	const std::string &namePrefix,
+	const std::function<void(GLC_World &)> &chunkLoaded,
+	RepoMeshIndexCache *indexCache)
 {
+	const int threadCount = getThreadCount();
+
 	//-------------------------------------------------------------------------
 	// Temporary textures
-	QHash<QString, GLC_Texture> glcTextures;
-	for (std::map<std::string, QImage>::const_iterator it = textures.begin(); 
-		it != textures.end(); ++it)
-	{
-		const QString name(it->first.c_str());
-		if (!it->second.isNull())
-			glcTextures.insert(name, GLC_Texture(it->second, name));
-	}
+	QHash<QString, GLC_Texture> glcTextures = toGLCTextures(textures, threadCount);
+
+	const qint64 peakMemoryBefore = RepoMemory::getPeakResidentBytes();
 
 	//-------------------------------------------------------------------------
 	// Allocate materials
+	// Each worker fills in its own slot so the order matches the aiScene.
 	QVector<GLC_Material *> glcMaterials(assimpScene->mNumMaterials);
-	for (unsigned int i = 0; i < assimpScene->mNumMaterials; ++i)
-		glcMaterials[i] = toGLCMaterial(
+	RepoThreadPool::parallelFor(
+		assimpScene->mNumMaterials,
+		[&](int i) {
+			glcMaterials[i] = toGLCMaterial(
 				assimpScene->mMaterials[i],
 				glcTextures);
+		},
+		threadCount);
 
 	//-------------------------------------------------------------------------
-	// Allocate meshes
-	QVector<GLC_3DRep*> glcMeshes(assimpScene->mNumMeshes);
-	for (unsigned int i = 0; i < assimpScene->mNumMeshes; ++i)
-		glcMeshes[i] = toGLCMesh(assimpScene->mMeshes[i], glcMaterials, namePrefix);
+	// Pool equal materials
+	QHash<QString, GLC_Material*> glcMaterialsPool = poolMaterials(glcMaterials);
 
 	//-------------------------------------------------------------------------
 	// Allocate cameras
@@ -63,8 +96,137 @@ GLC_World repo::gui::RepoTranscoderAssimp::toGLCWorld(
 			QString(assimpScene->mCameras[i]->mName.data),
 			toGLCCamera(assimpScene->mCameras[i]));
 
+	//-------------------------------------------------------------------------
+	// Allocate meshes
+	// If streaming, meshes are converted subtree by subtree first so that
+	// they can be displayed straight away, the rest is converted in one go.
+	// Coarser levels of detail are simplified on the conversion threads too.
+	const QVector<double> lodErrors = getLodErrors();
+	RepoIndexOptimizer indexOptimizer;
+	RepoIndexOptimizer *pIndexOptimizer = 
+		getIndexOptimization() ? &indexOptimizer : NULL;
+	const bool compactAttributes = getCompactAttributes();
+	QTime meshesTime;
+	meshesTime.start();
+	QVector<GLC_3DRep*> glcMeshes(assimpScene->mNumMeshes, NULL);
+	if (chunkLoaded && assimpScene->mRootNode)
+		toGLCChunks(
+			assimpScene, 
+			glcMaterials, 
+			glcCameras, 
+			namePrefix, 
+			lodErrors,
+			pIndexOptimizer,
+			compactAttributes,
+			threadCount, 
+			glcMeshes, 
+			chunkLoaded,
+			indexCache);
+
+	QVector<unsigned int> remainingMeshes;
+	for (unsigned int i = 0; i < assimpScene->mNumMeshes; ++i)
+		if (NULL == glcMeshes[i])
+			remainingMeshes << i;
+	RepoThreadPool::parallelFor(
+		remainingMeshes.size(),
+		[&](int i) {
+			glcMeshes[remainingMeshes[i]] = toGLCMesh(
+				assimpScene->mMeshes[remainingMeshes[i]],
+				glcMaterials,
+				namePrefix,
+				lodErrors,
+				pIndexOptimizer,
+				compactAttributes,
+				indexCache);
+		},
+		threadCount);
+
+	int lodMeshesCount = 0;
+	int lodsCount = 0;
+	qint64 compactBytes = 0;
+	qint64 compactFloatBytes = 0;
+	for (int i = 0; i < glcMeshes.size(); ++i)
+	{
+		const RepoGLCMesh *glcMesh = glcMeshes[i] && glcMeshes[i]->numberOfBody() > 0 ?
+			dynamic_cast<const RepoGLCMesh*>(glcMeshes[i]->geomAt(0)) : NULL;
+		if (glcMesh && !glcMesh->getLodErrors().isEmpty())
+		{
+			++lodMeshesCount;
+			lodsCount += glcMesh->getLodErrors().size();
+		}
+		if (glcMesh && glcMesh->hasCompactAttributes())
+		{
+			const aiMesh *assimpMesh = assimpScene->mMeshes[i];
+			int floatsCount = 3;
+			if (assimpMesh->HasNormals())
+				floatsCount += 3;
+			if (assimpMesh->HasTextureCoords(0))
+				floatsCount += 2;
+			compactBytes += glcMesh->getCompactBytes();
+			compactFloatBytes += 
+				(qint64) assimpMesh->mNumVertices * floatsCount * sizeof(GLfloat);
+		}
+	}
+	std::cout << "Converted " << glcMeshes.size() << " meshes in ";
+	std::cout << meshesTime.elapsed() << " ms, " << lodMeshesCount;
+	std::cout << " of them with " << lodsCount << " coarser levels of detail";
+	std::cout << std::endl;
+	if (pIndexOptimizer)
+	{
+		std::cout << "Vertex cache ACMR of " << indexOptimizer.getTrianglesCount();
+		std::cout << " triangles: " << indexOptimizer.getACMRBefore() << " before and ";
+		std::cout << indexOptimizer.getACMRAfter() << " after reordering" << std::endl;
+	}
+
+	//-------------------------------------------------------------------------
+	// Memory high-water mark
+	// Vertex attributes are copied once out of Assimp straight into the 
+	// vectors handed to GLC, the former path additionally held a QList copy
+	// of all positions (one pointer sized node per float) for triangulation.
+	// Both attribute figures are computed from the mesh sizes, only the peak
+	// resident memory is measured.
+	qint64 attributeBytes = 0;
+	qint64 positionBytes = 0;
+	for (unsigned int i = 0; i < assimpScene->mNumMeshes; ++i)
+	{
+		const aiMesh *assimpMesh = assimpScene->mMeshes[i];
+		const qint64 vertexBytes = 
+			(qint64) assimpMesh->mNumVertices * 3 * sizeof(GLfloat);
+		positionBytes += vertexBytes;
+		attributeBytes += vertexBytes;
+		if (assimpMesh->HasNormals())
+			attributeBytes += vertexBytes;
+		if (assimpMesh->HasTextureCoords(0))
+			attributeBytes += (qint64) assimpMesh->mNumVertices * 2 * sizeof(GLfloat);
+		if (assimpMesh->HasVertexColors(0))
+			attributeBytes += (qint64) assimpMesh->mNumVertices * 4 * sizeof(GLfloat);
+	}
+	const qint64 formerAttributeBytes = attributeBytes + 
+		positionBytes / sizeof(GLfloat) * sizeof(void*);
+	const qint64 peakMemoryAfter = RepoMemory::getPeakResidentBytes();
+	std::cout << "Vertex attributes (estimated from mesh sizes): " 
+		<< RepoMemory::toMegabytes(attributeBytes) << " MB copied, ";
+	std::cout << RepoMemory::toMegabytes(formerAttributeBytes) 
+		<< " MB on the former QList path" << std::endl;
+	std::cout << "Peak resident memory (measured): ";
+	std::cout << RepoMemory::toMegabytes(peakMemoryBefore) << " MB before and ";
+	std::cout << RepoMemory::toMegabytes(peakMemoryAfter) 
+		<< " MB after mesh conversion (";
+	std::cout << RepoTranscoderKernels::getKernelsName().toStdString()
+		<< " kernels)" << std::endl;
+	if (compactAttributes)
+	{
+		std::cout << "Compact vertex attributes take " 
+			<< RepoMemory::toMegabytes(compactBytes) << " MB instead of ";
+		std::cout << RepoMemory::toMegabytes(compactFloatBytes) 
+			<< " MB of floats" << std::endl;
+	}
+
 	//-------------------------------------------------------------------------
 	// Recursively build the scene graph
+	// References are shared by all nodes pointing at the same set of meshes.
+	QHash<QString, GLC_StructReference*> glcReferences;
+	unsigned int meshInstancesCount = 0;
 	GLC_World world;
 	if (assimpScene->mRootNode)
 	{
@@ -73,8 +235,17 @@ GLC_World repo::gui::RepoTranscoderAssimp::toGLCWorld(
 				assimpScene, 
 				assimpScene->mRootNode,
 				glcMeshes,
-				glcCameras)); 
+				glcCameras,
+				glcReferences,
+				meshInstancesCount)); 
 		tempWorld->setRootName(QString(assimpScene->mRootNode->mName.data));
+
+		std::cout << meshInstancesCount << " mesh instances share ";
+		std::cout << glcReferences.size() << " unique references";
+		if (glcReferences.size() > 0)
+			std::cout << " (dedup ratio " 
+				<< (double) meshInstancesCount / glcReferences.size() << ":1)";
+		std::cout << std::endl;
 	
 		//---------------------------------------------------------------------
 		// Clean and update positions
@@ -86,6 +257,12 @@ GLC_World repo::gui::RepoTranscoderAssimp::toGLCWorld(
 		delete tempWorld;
 	}
 
+	//-------------------------------------------------------------------------
+	// Remove only unused materials.
+	// Has to happen before the temporary meshes are deleted.
+	deleteUnusedMaterials(glcMaterialsPool);
+	glcMaterials.clear();
+
 	//-------------------------------------------------------------------------
 	// Clean up temporary meshes
 	for (unsigned int i = 0; i < glcMeshes.size(); ++i)
@@ -105,69 +282,383 @@ GLC_World repo::gui::RepoTranscoderAssimp::toGLCWorld(
 	}
 	glcCameras.clear();
 
-	//-------------------------------------------------------------------------
-	// Remove only unused materials.
-/*	for (unsigned int i = 0; i < glcMaterials.size(); ++i)
+	return world;
+}
+
+QHash<QString, GLC_Texture> repo::gui::RepoTranscoderAssimp::toGLCTextures(
+	const std::map<std::string, QImage> &textures,
+	int threadCount)
+{
+	// Images are shared through the process-wide cache, each window then picks
+	// the resolution its viewport needs. Downsampled levels of new images are
+	// generated in parallel.
+	QVector<const std::pair<const std::string, QImage> *> textureEntries;
+	for (std::map<std::string, QImage>::const_iterator it = textures.begin(); 
+		it != textures.end(); ++it)
+	{
+		if (!it->second.isNull())
+			textureEntries << &(*it);
+	}
+	QVector<QByteArray> textureKeys(textureEntries.size());
+	RepoTextureCache &textureCache = RepoTextureCache::instance();
+	RepoThreadPool::parallelFor(
+		textureEntries.size(),
+		[&](int i) {
+			textureKeys[i] = textureCache.insert(textureEntries[i]->second);
+		},
+		threadCount);
+
+	QHash<QString, GLC_Texture> glcTextures;
+	for (int i = 0; i < textureEntries.size(); ++i)
+	{
+		const QString name(textureEntries[i]->first.c_str());
+		QImage image = textureCache.getImage(textureKeys[i]);
+		if (image.isNull()) // evicted in the meantime
+			image = textureEntries[i]->second;
+		glcTextures.insert(name, GLC_Texture(image, name));
+	}
+	if (!textureEntries.isEmpty())
 	{
-		if (glcMaterials[i] && glcMaterials[i]->isUnused())
+		std::cout << "Texture cache: " << textureCache.getImagesCount();
+		std::cout << " images, " 
+			<< RepoMemory::toMegabytes(textureCache.getMemoryUsage()) << " MB, ";
+		std::cout << textureCache.getHitRate() * 100 << "% hit rate" << std::endl;
+	}
+	return glcTextures;
+}
+
+std::map<std::string, QImage> repo::gui::RepoTranscoderAssimp::getPlaceholderTextures(
+	const std::vector<std::string> &names)
+{
+	QImage placeholder(1, 1, QImage::Format_ARGB32);
+	placeholder.fill(Qt::white);
+	std::map<std::string, QImage> textures;
+	for (unsigned int i = 0; i < names.size(); ++i)
+		textures.insert(std::make_pair(names[i], placeholder));
+	return textures;
+}
+
+std::vector<std::string> repo::gui::RepoTranscoderAssimp::sortTexturesBySize(
+	const GLC_World &glcWorld,
+	const std::vector<std::string> &names)
+{
+	QHash<QString, double> textureSizes;
+	getTextureSizes(glcWorld.rootOccurence(), textureSizes);
+
+	std::vector<std::pair<double, std::string> > order;
+	for (unsigned int i = 0; i < names.size(); ++i)
+		order.push_back(std::make_pair(
+			-textureSizes.value(QString::fromStdString(names[i]), 0.0), 
+			names[i]));
+	std::stable_sort(order.begin(), order.end());
+
+	std::vector<std::string> sortedNames;
+	for (unsigned int i = 0; i < order.size(); ++i)
+		sortedNames.push_back(order[i].second);
+	return sortedNames;
+}
+
+void repo::gui::RepoTranscoderAssimp::loadDeferredTextures(
+	const std::vector<std::string> &names,
+	const std::function<QImage(const std::string &)> &decode,
+	const std::function<void(const QString &, const QImage &)> &textureLoaded,
+	int threadCount)
+{
+	// Indices are handed out in order, hence the first textures are decoded
+	// first even though several are decoded at a time.
+	QTime time;
+	time.start();
+	QAtomicInt loadedCount(0);
+	RepoTextureCache &textureCache = RepoTextureCache::instance();
+	RepoThreadPool::parallelFor(
+		(int) names.size(),
+		[&](int i) {
+			const QImage image = decode(names[i]);
+			if (!image.isNull())
+			{
+				const QImage cachedImage = 
+					textureCache.getImage(textureCache.insert(image));
+				textureLoaded(
+					QString::fromStdString(names[i]), 
+					cachedImage.isNull() ? image : cachedImage);
+				loadedCount.fetchAndAddOrdered(1);
+			}
+		},
+		threadCount);
+	if (!names.empty())
+	{
+		std::cout << "Loaded " << loadedCount.load() << " of " << names.size();
+		std::cout << " deferred textures in " << time.elapsed() << " ms" << std::endl;
+	}
+}
+
+QHash<QString, GLC_Material*> repo::gui::RepoTranscoderAssimp::poolMaterials(
+	QVector<GLC_Material*> &glcMaterials)
+{
+	// Exporters often emit many identical materials, only the first of each
+	// is kept so that meshes share it. None is attached to a mesh yet, hence
+	// duplicates can be deleted straight away.
+	QHash<QString, GLC_Material*> glcMaterialsPool;
+	int materialsCount = 0;
+	for (int i = 0; i < glcMaterials.size(); ++i)
+	{
+		if (NULL == glcMaterials[i])
+			continue;
+		++materialsCount;
+		const QString materialKey = getMaterialKey(glcMaterials[i]);
+		GLC_Material * pooledMaterial = glcMaterialsPool.value(materialKey, NULL);
+		if (NULL != pooledMaterial)
+		{
 			delete glcMaterials[i];
+			glcMaterials[i] = pooledMaterial;
+		}
+		else
+			glcMaterialsPool.insert(materialKey, glcMaterials[i]);
 	}
-*/
-	return world;
+	std::cout << materialsCount << " materials pooled into ";
+	std::cout << glcMaterialsPool.size() << " unique materials" << std::endl;
+	return glcMaterialsPool;
+}
+
+void repo::gui::RepoTranscoderAssimp::deleteUnusedMaterials(
+	QHash<QString, GLC_Material*> &glcMaterialsPool)
+{
+	// Geometries delete their own materials once no longer used by any of 
+	// them, hence the temporary meshes must still be alive at this point.
+	QHash<QString, GLC_Material*>::iterator it;
+	for (it = glcMaterialsPool.begin(); it != glcMaterialsPool.end(); ++it)
+	{
+		if (it.value()->isUnused())
+			delete it.value();
+	}
+	glcMaterialsPool.clear();
+}
+
+void repo::gui::RepoTranscoderAssimp::toGLCChunks(
+	const aiScene * assimpScene,
+	const QVector<GLC_Material*> &glcMaterials,
+	const QHash<const QString, GLC_3DRep*> &glcCameras,
+	const std::string &namePrefix,
+	const QVector<double> &lodErrors,
+	RepoIndexOptimizer *indexOptimizer,
+	bool compactAttributes,
+	int threadCount,
+	QVector<GLC_3DRep*> &glcMeshes,
+	const std::function<void(GLC_World &)> &chunkLoaded,
+	RepoMeshIndexCache *indexCache)
+{
+	//-------------------------------------------------------------------------
+	// Descend through single child nodes without meshes (eg a root with just
+	// a "Scene" node) so that there are enough subtrees to stream.
+	QList<const aiNode*> path;
+	const aiNode * streamingRoot = assimpScene->mRootNode;
+	path << streamingRoot;
+	while (1 == streamingRoot->mNumChildren && 0 == streamingRoot->mNumMeshes)
+	{
+		streamingRoot = streamingRoot->mChildren[0];
+		path << streamingRoot;
+	}
+
+	QTime time;
+	time.start();
+	int chunksCount = 0;
+	QList<const aiNode*> pendingNodes;
+	for (unsigned int c = 0; c < streamingRoot->mNumChildren; ++c)
+	{
+		//---------------------------------------------------------------------
+		// Convert meshes of the next subtree
+		const aiNode * child = streamingRoot->mChildren[c];
+		QSet<unsigned int> meshIndicesSet;
+		getMeshIndices(child, glcMeshes, meshIndicesSet);
+		const QVector<unsigned int> meshIndices = meshIndicesSet.toList().toVector();
+		RepoThreadPool::parallelFor(
+			meshIndices.size(),
+			[&](int i) {
+				glcMeshes[meshIndices[i]] = toGLCMesh(
+					assimpScene->mMeshes[meshIndices[i]],
+					glcMaterials,
+					namePrefix,
+					lodErrors,
+					indexOptimizer,
+					compactAttributes,
+					indexCache);
+			},
+			threadCount);
+		pendingNodes << child;
+
+		//---------------------------------------------------------------------
+		// Send the first subtree right away and the rest in regular intervals.
+		// The chunk copies the path down to the streaming root so that its
+		// subtrees end up with their final absolute transformations.
+		// It shares no geometry nor materials with the converted meshes, the
+		// GUI thread renders it while this thread goes on with the rest.
+		const bool isLast = (c + 1 == streamingRoot->mNumChildren);
+		if (0 == chunksCount || isLast || 
+			time.elapsed() >= REPO_TRANSCODER_CHUNK_INTERVAL)
+		{
+			QVector<GLC_3DRep*> chunkMeshes(glcMeshes.size(), NULL);
+			QSet<unsigned int> chunkMeshIndices;
+			for (int i = 0; i < pendingNodes.size(); ++i)
+				getMeshIndices(pendingNodes[i], chunkMeshes, chunkMeshIndices);
+			QHash<GLC_Material*, GLC_Material*> chunkMaterials;
+			QSet<unsigned int>::const_iterator it;
+			for (it = chunkMeshIndices.begin(); it != chunkMeshIndices.end(); ++it)
+				if (glcMeshes[*it])
+					chunkMeshes[*it] = cloneGLCMesh(glcMeshes[*it], chunkMaterials);
+			QHash<const QString, GLC_3DRep*> chunkCameras;
+			QHash<const QString, GLC_3DRep*>::const_iterator cit;
+			for (cit = glcCameras.begin(); cit != glcCameras.end(); ++cit)
+				chunkCameras.insert(cit.key(), cloneGLCMesh(cit.value(), chunkMaterials));
+
+			QHash<QString, GLC_StructReference*> chunkReferences;
+			unsigned int chunkInstancesCount = 0;
+			GLC_World chunk;
+			GLC_StructOccurence * parent = chunk.rootOccurence();
+			for (int i = 0; i < path.size(); ++i)
+			{
+				const QString name(path[i]->mName.C_Str());
+				GLC_StructInstance * instance = 
+					new GLC_StructInstance(new GLC_StructReference(name));
+				instance->setName(name);
+				instance->move(toGLCMatrix(path[i]->mTransformation));
+				GLC_StructOccurence * occurrence = new GLC_StructOccurence(instance);
+				occurrence->setName(name);
+				parent->addChild(occurrence);
+				parent = occurrence;
+			}
+			for (int i = 0; i < pendingNodes.size(); ++i)
+				parent->addChild(
+					createOccurrenceFromNode(
+						assimpScene,
+						pendingNodes[i],
+						chunkMeshes,
+						chunkCameras,
+						chunkReferences,
+						chunkInstancesCount));
+			chunk.rootOccurence()->updateChildrenAbsoluteMatrix();
+			for (int i = 0; i < chunkMeshes.size(); ++i)
+				delete chunkMeshes[i];
+			qDeleteAll(chunkCameras);
+
+			// The receiver clears the chunk on its own thread once merged.
+			chunkLoaded(chunk);
+
+			pendingNodes.clear();
+			++chunksCount;
+			time.restart();
+		}
+	}
+	std::cout << "Streamed " << streamingRoot->mNumChildren << " subtrees in ";
+	std::cout << chunksCount << " chunks" << std::endl;
+}
+
+void repo::gui::RepoTranscoderAssimp::getMeshIndices(
+	const aiNode * assimpNode,
+	const QVector<GLC_3DRep*> &glcMeshes,
+	QSet<unsigned int> &meshIndices)
+{
+	for (unsigned int i = 0; i < assimpNode->mNumMeshes; ++i)
+	{
+		const unsigned int index = assimpNode->mMeshes[i];
+		if (NULL == glcMeshes[index])
+			meshIndices.insert(index);
+	}
+	for (unsigned int i = 0; i < assimpNode->mNumChildren; ++i)
+		getMeshIndices(assimpNode->mChildren[i], glcMeshes, meshIndices);
+}
+
+GLC_3DRep* repo::gui::RepoTranscoderAssimp::cloneGLCMesh(
+	const GLC_3DRep *glcMesh,
+	QHash<GLC_Material*, GLC_Material*> &glcMaterialClones)
+{
+	// Vertex data is implicitly shared, which is thread safe unlike the
+	// reference counts of GLC representations and material usages.
+	GLC_3DRep *clone = new GLC_3DRep();
+	clone->setName(glcMesh->name());
+	for (int i = 0; i < glcMesh->numberOfBody(); ++i)
+	{
+		GLC_Geometry *geometry = glcMesh->geomAt(i)->clone();
+		GLC_Mesh *mesh = dynamic_cast<GLC_Mesh*>(geometry);
+		const QSet<GLC_Material*> materials = geometry->materialSet();
+		QSet<GLC_Material*>::const_iterator it;
+		for (it = materials.begin(); mesh && it != materials.end(); ++it)
+		{
+			GLC_Material *materialClone = glcMaterialClones.value(*it, NULL);
+			if (NULL == materialClone)
+			{
+				materialClone = new GLC_Material(**it);
+				glcMaterialClones.insert(*it, materialClone);
+			}
+			mesh->replaceMaterial((*it)->id(), materialClone);
+		}
+		clone->addGeom(geometry);
+	}
+	return clone;
 }
 
 GLC_StructOccurence* repo::gui::RepoTranscoderAssimp::createOccurrenceFromNode(
 	const aiScene* assimpScene, 
 	const aiNode* assimpNode,
 	const QVector<GLC_3DRep*>& glcMeshes,
-	const QHash<const QString, GLC_3DRep*>& glcCameras)
+	const QHash<const QString, GLC_3DRep*>& glcCameras,
+	QHash<QString, GLC_StructReference*>& glcReferences,
+	unsigned int& meshInstancesCount)
 {
 	Q_ASSERT (NULL != assimpNode);
 	QString name(assimpNode->mName.C_Str());
 	GLC_StructInstance* instance = NULL;
 	GLC_StructOccurence* occurrence = NULL;	
 	
-	// TODO: store instance objects in a hash map based on their attached
-	// meshes to reduce duplication of geometry. If instance already defined
-	// and found in the hash map, skip the meshes section below.
-
 	//-------------------------------------------------------------------------
 	// Meshes
 	if (assimpNode->mNumMeshes > 0)
 	{
-		GLC_3DRep* pRep = NULL;
-		for (unsigned int i = 0; i < assimpNode->mNumMeshes; ++i)
+		++meshInstancesCount;
+		const QString referenceKey = getReferenceKey(assimpNode);
+		GLC_StructReference* reference = glcReferences.value(referenceKey, NULL);
+		if (NULL != reference)
 		{
-			GLC_3DRep * glcMesh = glcMeshes[assimpNode->mMeshes[i]];
-			if (glcMesh)
+			// Geometry already converted for another node, share it so that
+			// only the instance transformation differs.
+			instance = new GLC_StructInstance(reference);
+		}
+		else
+		{
+			GLC_3DRep* pRep = NULL;
+			for (unsigned int i = 0; i < assimpNode->mNumMeshes; ++i)
 			{
-				if (NULL == pRep)
-					pRep = new GLC_3DRep(*glcMesh);
-				else
-					pRep->merge(glcMesh); // instead of merging pRep
+				GLC_3DRep * glcMesh = glcMeshes[assimpNode->mMeshes[i]];
+				if (glcMesh)
+				{
+					if (NULL == pRep)
+						pRep = new GLC_3DRep(*glcMesh);
+					else
+						pRep->merge(glcMesh); // instead of merging pRep
+				}
 			}
-		}
 		
-		if (NULL != pRep)
-		{
-			pRep->clean();
-			if (pRep->isEmpty())
+			if (NULL != pRep)
 			{
-                std::cerr << "Empty geometry in node " << name.toStdString() << std::endl;
-				delete pRep;
-				pRep = 0;
-				instance = new GLC_StructInstance(new GLC_StructReference(name));	
+				pRep->clean();
+				if (pRep->isEmpty())
+				{
+					std::cerr << "Empty geometry in node " << name.toStdString() << std::endl;
+					delete pRep;
+					pRep = 0;
+					instance = new GLC_StructInstance(new GLC_StructReference(name));	
+				}
+				else
+				{
+					reference = new GLC_StructReference(pRep);
+					glcReferences.insert(referenceKey, reference);
+					instance = new GLC_StructInstance(reference);
+				}
 			}
 			else
-				instance = new GLC_StructInstance(new GLC_StructReference(pRep));
-
-			// Save instance in instance hash Table
-			//m_StructInstanceHash.insert(pNode->m_Id, pInstance);			
-		}
-		else
-		{
-            std::cerr << "NULL geometry in node " << name.toStdString() << std::endl;
-			instance = new GLC_StructInstance(new GLC_StructReference(name));	
+			{
+				std::cerr << "NULL geometry in node " << name.toStdString() << std::endl;
+				instance = new GLC_StructInstance(new GLC_StructReference(name));	
+			}
 		}
 	}
 	else // No meshes in this node
@@ -199,7 +690,9 @@ GLC_StructOccurence* repo::gui::RepoTranscoderAssimp::createOccurrenceFromNode(
 					assimpScene, 
 					assimpNode->mChildren[i],
 					glcMeshes,
-					glcCameras));
+					glcCameras,
+					glcReferences,
+					meshInstancesCount));
 	}
 	return occurrence;
 }
@@ -283,28 +776,41 @@ GLC_Material * repo::gui::RepoTranscoderAssimp::toGLCMaterial(
 GLC_3DRep* repo::gui::RepoTranscoderAssimp::toGLCMesh(
 	const aiMesh * assimpMesh,
 	const QVector<GLC_Material*>& glcMaterials,
-	const std::string &namePrefix)
+	const std::string &namePrefix,
+	const QVector<double> &lodErrors,
+	RepoIndexOptimizer *indexOptimizer,
+	bool compactAttributes,
+	RepoMeshIndexCache *indexCache)
 {
-	GLC_Mesh * glcMesh = new GLC_Mesh;
+	RepoGLCMesh * glcMesh = new RepoGLCMesh;
 	std::string name = namePrefix + assimpMesh->mName.C_Str();
 	glcMesh->setName(QString::fromStdString(name));
 			
+	//-----------------------------------------------------------------
+	// Compact attributes
+	// Vertex colours are not supported by the compact shader.
+	const bool isCompact = compactAttributes && !assimpMesh->HasVertexColors(0);
+
 	//-----------------------------------------------------------------
 	// Vertices
-	const QVector<GLfloat> vertices = toGLCVector(
+	// Passed on directly, Qt's implicit sharing avoids any further copy.
+	const QVector<GLfloat> positions = toGLCVector(
 		assimpMesh->mVertices, 
 		assimpMesh->mNumVertices,
 		XYZ);
-	glcMesh->addVertice(vertices);
+	if (!isCompact)
+		glcMesh->addVertice(positions);
 					
 	//-----------------------------------------------------------------
 	// Normals
+	QVector<GLfloat> normals;
 	if (assimpMesh->HasNormals())
-		glcMesh->addNormals(
-			toGLCVector(
-				assimpMesh->mNormals, 
-				assimpMesh->mNumVertices,
-				XYZ));
+		normals = toGLCVector(
+			assimpMesh->mNormals, 
+			assimpMesh->mNumVertices,
+			XYZ);
+	if (!isCompact && !normals.isEmpty())
+		glcMesh->addNormals(normals);
 
 	//-----------------------------------------------------------------
 	// Vertex colours
@@ -341,41 +847,140 @@ GLC_3DRep* repo::gui::RepoTranscoderAssimp::toGLCMesh(
 		
 	//-------------------------------------------------------------------------
 	// Faces (triangles) with assigned material
+	bool hasLines = false;
 	if (assimpMesh->HasFaces())
 	{
-		glcMesh->addTriangles(
-			glcMaterials[assimpMesh->mMaterialIndex], 
-			toGLCList(
-				vertices.toList(),
-				assimpMesh->mFaces, 
-				assimpMesh->mNumFaces));
+		QList<GLuint> triangles = toGLCList(
+			assimpMesh->mVertices,
+			assimpMesh->mFaces, 
+			assimpMesh->mNumFaces);
+
+		//---------------------------------------------------------------------
+		// Cached triangle lists
+		// Reordering and simplification are by far the most expensive part
+		// of the conversion, their results are reused for unchanged meshes.
+		QByteArray cacheKey;
+		if (indexCache)
+			cacheKey = RepoMeshIndexCache::getKey(
+				positions.constData(), 
+				positions.size(), 
+				triangles);
+		RepoMeshIndexCache::Entry cached;
+		const bool isCached = indexCache && 
+			indexCache->find(cacheKey, cached) &&
+			cached.triangles.size() == triangles.size() &&
+			cached.lods.size() == cached.lodErrors.size();
+		if (isCached)
+			triangles = cached.triangles;
+
+		// Exporters often write triangles in an order unfriendly to the
+		// post-transform vertex cache.
+		else if (indexOptimizer)
+			triangles = indexOptimizer->optimize(
+				triangles, 
+				positions.constData(), 
+				assimpMesh->mNumVertices);
+
+		{
+			// Materials are shared by meshes converted on other threads.
+			QMutexLocker locker(&glcMaterialsMutex);
+			glcMesh->addTriangles(
+				glcMaterials[assimpMesh->mMaterialIndex], 
+				triangles);
+			for (int i = 0; isCached && i < cached.lods.size(); ++i)
+				glcMesh->addLod(
+					glcMaterials[assimpMesh->mMaterialIndex],
+					cached.lods[i],
+					cached.lodErrors[i]);
+		}
+
+		//---------------------------------------------------------------------
+		// Levels of detail
+		// Each level continues simplifying the previous one up to the next
+		// error target, levels which barely reduce the triangle count are
+		// skipped.
+		RepoMeshIndexCache::Entry computed;
+		computed.triangles = triangles;
+		if (!isCached && !lodErrors.isEmpty() && 
+			triangles.size() / 3 >= REPO_TRANSCODER_LOD_MIN_TRIANGLES)
+		{
+			RepoMeshSimplifier simplifier(
+				positions.constData(), 
+				assimpMesh->mNumVertices, 
+				triangles);
+			int trianglesCount = simplifier.getTrianglesCount();
+			for (int i = 0; i < lodErrors.size() && simplifier.getDiameter() > 0; ++i)
+			{
+				QList<GLuint> lod = simplifier.simplify(
+					lodErrors[i] * simplifier.getDiameter());
+				if (!lod.isEmpty() && lod.size() / 3 <= trianglesCount * 3 / 4)
+				{
+					trianglesCount = lod.size() / 3;
+					if (indexOptimizer)
+						lod = RepoIndexOptimizer::reorder(
+							lod, 
+							positions.constData(), 
+							assimpMesh->mNumVertices);
+					const double lodError = 
+						simplifier.getError() / simplifier.getDiameter();
+					computed.lods << lod;
+					computed.lodErrors << lodError;
+					QMutexLocker locker(&glcMaterialsMutex);
+					glcMesh->addLod(
+						glcMaterials[assimpMesh->mMaterialIndex],
+						lod,
+						lodError);
+				}
+			}
+		}
+		if (indexCache && !isCached)
+			indexCache->insert(cacheKey, computed);
 
 		//---------------------------------------------------------------------
 		// Wireframe
 		// Since GLC_Lib renders only triangles, the wireframe for polygon
-		// faces has to be created separately.
-		GLfloatVector faceVertices;
-		aiVector3D vertex;
-		for (unsigned int i = 0; i < assimpMesh->mNumFaces; ++i)
+		// faces has to be created separately. Only the compact outlines of
+		// the original polygons are kept here, the wire itself is built by
+		// RepoGLCMesh when it is first rendered. Triangle meshes need none.
+		// Line faces are open outlines, and since they are not part of the
+		// triangles they are the only way to draw them. Their wire is built
+		// right away, once the positions are in, as it has to show in the
+		// shaded view too.
+		if (!isTriangulated(assimpMesh->mFaces, assimpMesh->mNumFaces))
 		{
-			for (unsigned int j = 0; j < assimpMesh->mFaces[i].mNumIndices; ++j)
+			QVector<GLuint> outlineIndices;
+			QVector<GLuint> outlineSizes;
+			outlineSizes.reserve(assimpMesh->mNumFaces);
+			outlineIndices.reserve(assimpMesh->mNumFaces * 4);
+			for (unsigned int i = 0; i < assimpMesh->mNumFaces; ++i)
 			{
-				vertex = assimpMesh->mVertices[assimpMesh->mFaces[i].mIndices[j]];
-				faceVertices << vertex.x << vertex.y << vertex.z;
+				const aiFace &assimpFace = assimpMesh->mFaces[i];
+				if (assimpFace.mNumIndices < 2)
+					continue;
+				hasLines = hasLines || 2 == assimpFace.mNumIndices;
+				for (unsigned int j = 0; j < assimpFace.mNumIndices; ++j)
+					outlineIndices << assimpFace.mIndices[j];
+				outlineSizes << assimpFace.mNumIndices;
 			}
-			glcMesh->addVerticeGroup(faceVertices);
-			faceVertices.clear();
+			glcMesh->setPolygonOutlines(outlineIndices, outlineSizes);
 		}
 	}
 
 	//-------------------------------------------------------------------------
 	// Texture coordinates
 	// Assimp provides multiple textures per vertex eg U, UV or UVW
+	QVector<GLfloat> texels;
 	if (assimpMesh->HasTextureCoords(0))
-		glcMesh->addTexels(toGLCVector(
+		texels = toGLCVector(
 			assimpMesh->mTextureCoords[0],
 			assimpMesh->mNumVertices,
-			XY));
+			XY);
+	if (isCompact)
+		glcMesh->setCompactAttributes(positions, normals, texels);
+	else if (!texels.isEmpty())
+		glcMesh->addTexels(texels);
+	if (hasLines)
+		glcMesh->createPolygonWireframe();
 		
 	//-----------------------------------------------------------------
 	// Copy index list in a vector for Vertex Array Use
@@ -388,6 +993,68 @@ GLC_3DRep* repo::gui::RepoTranscoderAssimp::toGLCMesh(
 }
 
 
+int repo::gui::RepoTranscoderAssimp::getThreadCount()
+{
+	QSettings settings;
+	return settings.value(REPO_SETTINGS_TRANSCODER_THREADS, 0).toInt();
+}
+
+void repo::gui::RepoTranscoderAssimp::setThreadCount(int threadCount)
+{
+	QSettings settings;
+	settings.setValue(REPO_SETTINGS_TRANSCODER_THREADS, threadCount);
+}
+
+bool repo::gui::RepoTranscoderAssimp::getIndexOptimization()
+{
+	QSettings settings;
+	return settings.value(REPO_SETTINGS_TRANSCODER_OPTIMIZE_INDICES, true).toBool();
+}
+
+void repo::gui::RepoTranscoderAssimp::setIndexOptimization(bool enabled)
+{
+	QSettings settings;
+	settings.setValue(REPO_SETTINGS_TRANSCODER_OPTIMIZE_INDICES, enabled);
+}
+
+bool repo::gui::RepoTranscoderAssimp::getCompactAttributes()
+{
+	QSettings settings;
+	return settings.value(REPO_SETTINGS_TRANSCODER_COMPACT_ATTRIBUTES, false).toBool();
+}
+
+void repo::gui::RepoTranscoderAssimp::setCompactAttributes(bool enabled)
+{
+	QSettings settings;
+	settings.setValue(REPO_SETTINGS_TRANSCODER_COMPACT_ATTRIBUTES, enabled);
+}
+
+QVector<double> repo::gui::RepoTranscoderAssimp::getLodErrors()
+{
+	QSettings settings;
+	const QStringList values = settings.value(
+		REPO_SETTINGS_TRANSCODER_LOD_ERRORS,
+		QStringList() << "0.002" << "0.01" << "0.05").toStringList();
+	QVector<double> lodErrors;
+	for (int i = 0; i < values.size() && lodErrors.size() < REPO_TRANSCODER_LOD_MAX_COUNT; ++i)
+	{
+		bool ok = false;
+		const double error = values[i].toDouble(&ok);
+		if (ok && error > 0 && (lodErrors.isEmpty() || error > lodErrors.last()))
+			lodErrors << error;
+	}
+	return lodErrors;
+}
+
+void repo::gui::RepoTranscoderAssimp::setLodErrors(const QVector<double> &lodErrors)
+{
+	QStringList values;
+	for (int i = 0; i < lodErrors.size(); ++i)
+		values << QString::number(lodErrors[i]);
+	QSettings settings;
+	settings.setValue(REPO_SETTINGS_TRANSCODER_LOD_ERRORS, values);
+}
+
 GLC_3DRep * repo::gui::RepoTranscoderAssimp::toGLCCamera(const aiCamera * assimpCamera)
 {
 	GLC_Point3d position = toGLCPoint(assimpCamera->mPosition);
@@ -429,6 +1096,26 @@ QVector<GLfloat> repo::gui::RepoTranscoderAssimp::toGLCVector(
 	RepoOrdinates ordinatesType)
 {
 	QVector<GLfloat> glcVector(arraySize * ordinatesType); // always [x,y,z]
+
+	//-------------------------------------------------------------------------
+	// aiVector3D is a tightly packed triplet of floats, hence a single block
+	// copy suffices for XYZ.
+	if (XYZ == ordinatesType && sizeof(aiVector3D) == 3 * sizeof(GLfloat))
+	{
+		if (arraySize > 0)
+			memcpy(glcVector.data(), vertexArray, arraySize * sizeof(aiVector3D));
+		return glcVector;
+	}
+	else if (sizeof(aiVector3D) == 3 * sizeof(GLfloat))
+	{
+		const float * xyz = (const float *) vertexArray;
+		if (XY == ordinatesType)
+			RepoTranscoderKernels::packXY(xyz, glcVector.data(), arraySize);
+		else
+			RepoTranscoderKernels::packX(xyz, glcVector.data(), arraySize);
+		return glcVector;
+	}
+
 	for (unsigned int i = 0, j = 0; i < glcVector.size(); i += ordinatesType, ++j)
 	{
 		// This switch deliberately falls through to capture XYZ, XY or just X
@@ -451,6 +1138,13 @@ QVector<GLfloat> repo::gui::RepoTranscoderAssimp::toGLCVector(
 	unsigned int arraySize)
 {
 	QVector<GLfloat> glcVector(arraySize * 4); // always [r,g,b,a]
+	if (sizeof(aiColor4t<float>) == 4 * sizeof(GLfloat))
+	{
+		RepoTranscoderKernels::copyRGBA(
+			(const float *) colorArray, glcVector.data(), arraySize);
+		return glcVector;
+	}
+
 	for (unsigned int i = 0, j = 0; i < glcVector.size(); i += 4, ++j)
 	{
 		glcVector[i + 0] = ((GLfloat) (colorArray[j].r));
@@ -462,40 +1156,85 @@ QVector<GLfloat> repo::gui::RepoTranscoderAssimp::toGLCVector(
 }
 
 QList<GLuint> repo::gui::RepoTranscoderAssimp::toGLCList(
-	const QList<GLfloat> & verticesList,
+	const aiVector3D * vertexArray,
 	const aiFace * facesAarray, 
 	unsigned int size)
 {
 	QList<GLuint> glcList;
-	for (unsigned int i = 0; i < size; ++i)
+
+	//-------------------------------------------------------------------------
+	// Fast path for meshes made of triangles only (eg aiProcess_Triangulate)
+	// which are converted into a single flat index list in one go.
+	if (isTriangulated(facesAarray, size))
 	{
-		const aiFace assimpFace = facesAarray[i];		
-		QList<GLuint> glcFaceIndices;
-		glcFaceIndices.reserve(assimpFace.mNumIndices);
+		glcList.reserve(size * 3);
+		for (unsigned int i = 0; i < size; ++i)
+		{
+			const unsigned int *indices = facesAarray[i].mIndices;
+			glcList << indices[0] << indices[1] << indices[2];
+		}
+		return glcList;
+	}
 
-		//---------------------------------------------------------------------
-		// Copy all assimp indices of a single face to a QList
-		std::copy(
-			assimpFace.mIndices + 0, 
-			assimpFace.mIndices + assimpFace.mNumIndices, 
-			std::back_inserter(glcFaceIndices));
+	glcList.reserve(size * 3);
+	for (unsigned int i = 0; i < size; ++i)
+	{
+		const aiFace &assimpFace = facesAarray[i];		
 
 		//---------------------------------------------------------------------
 		// GLC 2.5.0 can render only up to triangles,
 		// hence triangulate all non-tri faces
-		if (glcFaceIndices.size() > 3) 
-			glc::triangulatePolygon(& glcFaceIndices, verticesList);
-		
-		glcList.append(glcFaceIndices);
+		if (3 == assimpFace.mNumIndices)
+		{
+			glcList << assimpFace.mIndices[0] 
+				<< assimpFace.mIndices[1] 
+				<< assimpFace.mIndices[2];
+		}
+		else if (assimpFace.mNumIndices > 3) 
+		{
+			// Triangulate against a local copy of this polygon's vertices 
+			// only, indexed 0..n-1, rather than a copy of the whole mesh.
+			QList<GLfloat> polygonVertices;
+			QList<GLuint> polygonIndices;
+			polygonVertices.reserve(assimpFace.mNumIndices * 3);
+			polygonIndices.reserve(assimpFace.mNumIndices);
+			for (unsigned int j = 0; j < assimpFace.mNumIndices; ++j)
+			{
+				const aiVector3D &vertex = vertexArray[assimpFace.mIndices[j]];
+				polygonVertices << vertex.x << vertex.y << vertex.z;
+				polygonIndices << j;
+			}
+			glc::triangulatePolygon(& polygonIndices, polygonVertices);
+
+			for (int j = 0; j < polygonIndices.size(); ++j)
+				glcList.append(assimpFace.mIndices[polygonIndices[j]]);
+		}
+		// Points and lines cannot be part of a triangle list.
 	}
 	return glcList;
 }
 
+bool repo::gui::RepoTranscoderAssimp::isTriangulated(
+	const aiFace * facesArray,
+	unsigned int size)
+{
+	bool triangulated = true;
+	for (unsigned int i = 0; triangulated && i < size; ++i)
+		triangulated = (3 == facesArray[i].mNumIndices);
+	return triangulated;
+}
+
 GLC_Matrix4x4 repo::gui::RepoTranscoderAssimp::toGLCMatrix
 	(const aiMatrix4x4 & assimpMatrix)
 {
 	// Assimp's is row-major while GLC is column-major
-	double * temp = new double[16];
+	double temp[16];
+	if (sizeof(aiMatrix4x4) == 16 * sizeof(float))
+	{
+		RepoTranscoderKernels::transpose4x4(
+			(const float *) &assimpMatrix.a1, temp);
+		return GLC_Matrix4x4(temp);
+	}
 	//-------------------------------------------------------------------------
 	temp[0]  = assimpMatrix.a1;
 	temp[4]  = assimpMatrix.a2;
@@ -518,10 +1257,64 @@ GLC_Matrix4x4 repo::gui::RepoTranscoderAssimp::toGLCMatrix
 	temp[15] = assimpMatrix.d4;
 	//-------------------------------------------------------------------------
 	GLC_Matrix4x4 glcMatrix(temp);
-	delete [] temp;
 	return glcMatrix;		
 }
 
+QString repo::gui::RepoTranscoderAssimp::getMaterialKey(
+	const GLC_Material * glcMaterial)
+{
+	QString key;
+	key += QString::number(glcMaterial->diffuseColor().rgba()) + ',';
+	key += QString::number(glcMaterial->specularColor().rgba()) + ',';
+	key += QString::number(glcMaterial->ambientColor().rgba()) + ',';
+	key += QString::number(glcMaterial->emissiveColor().rgba()) + ',';
+	key += QString::number(glcMaterial->opacity()) + ',';
+	key += QString::number(glcMaterial->shininess()) + ',';
+	if (glcMaterial->hasTexture())
+		key += glcMaterial->textureHandle()->fileName();
+	return key;
+}
+
+QString repo::gui::RepoTranscoderAssimp::getReferenceKey(const aiNode * assimpNode)
+{
+	QString key;
+	for (unsigned int i = 0; i < assimpNode->mNumMeshes; ++i)
+	{
+		if (i > 0)
+			key += ',';
+		key += QString::number(assimpNode->mMeshes[i]);
+	}
+	return key;
+}
+
+void repo::gui::RepoTranscoderAssimp::getTextureSizes(
+	const GLC_StructOccurence *occurrence,
+	QHash<QString, double> &textureSizes)
+{
+	if (!occurrence)
+		return;
+	if (occurrence->structInstance() && 
+		occurrence->structInstance()->structReference() &&
+		!occurrence->structInstance()->structReference()->representationIsEmpty())
+	{
+		const GLC_3DRep *glcRep = dynamic_cast<const GLC_3DRep*>(
+			occurrence->structInstance()->structReference()->representationHandle());
+		const double size = occurrence->boundingBox().boundingSphereRadius();
+		for (int i = 0; glcRep && i < glcRep->numberOfBody(); ++i)
+		{
+			const QSet<GLC_Material*> materials = glcRep->geomAt(i)->materialSet();
+			for (QSet<GLC_Material*>::const_iterator it = materials.begin(); 
+				it != materials.end(); ++it)
+			{
+				if ((*it)->hasTexture())
+					textureSizes[(*it)->textureHandle()->fileName()] += size;
+			}
+		}
+	}
+	for (int i = 0; i < occurrence->childCount(); ++i)
+		getTextureSizes(occurrence->child(i), textureSizes);
+}
+
 GLC_Point3d repo::gui::RepoTranscoderAssimp::toGLCPoint(const aiVector3D &v)
 {
 	return GLC_Point3d(v.x, v.y, v.z);
@@ -18,7 +18,9 @@
 #ifndef REPO_TRANSCODER_ASSIMP_H
 #define REPO_TRANSCODER_ASSIMP_H
 
+#include <functional>
 #include <string>
+#include <vector>
 //------------------------------------------------------------------------------
 #include <assimp/scene.h> 
 //------------------------------------------------------------------------------
@@ -28,6 +30,8 @@
 #include <QXmlStreamReader>
 #include <QHash>
 #include <QColor>
+#include <QSettings>
+#include <QSet>
 //------------------------------------------------------------------------------
 #include <GLC_Material>
 #include <GLC_World>
@@ -36,6 +40,9 @@
 #include "sceneGraph/glc_structoccurence.h"
 #include "maths/glc_geomtools.h"
 //------------------------------------------------------------------------------
+#include "../primitives/repo_indexoptimizer.h"
+#include "../primitives/repo_meshindexcache.h"
+//------------------------------------------------------------------------------
 namespace repo {
 namespace gui {
 
@@ -56,23 +63,89 @@ private:
 	
 public:
 
+	//! Minimum time in ms between two streamed chunks.
+	static const int REPO_TRANSCODER_CHUNK_INTERVAL = 1000;
+
+	//! Smallest mesh in triangles that gets coarser levels of detail.
+	static const int REPO_TRANSCODER_LOD_MIN_TRIANGLES = 512;
+
+	//! Largest number of coarser levels of detail per mesh.
+	static const int REPO_TRANSCODER_LOD_MAX_COUNT = 4;
+
 	//! Creates a world instance of a given scene.
+	/*!
+	 * Materials and meshes are converted in parallel on up to
+	 * getThreadCount() threads, the resulting order is that of the aiScene.
+	 *
+	 * If chunkLoaded is set, the scene is streamed: top level subtrees are
+	 * converted one after another and passed on in preview worlds as they
+	 * become ready, the returned world is the same as without streaming.
+	 * chunkLoaded is called from the calling thread.
+	 *
+	 * If indexCache is set, reordered triangles and levels of detail of
+	 * meshes found in it are reused, those of the other meshes are added.
+	 */
 	static GLC_World toGLCWorld(
 		const aiScene *,
 		const std::map<std::string, QImage> &,
-		const std::string & namePrefix = "");
+		const std::string & namePrefix = "",
+		const std::function<void(GLC_World &)> &chunkLoaded = 
+			std::function<void(GLC_World &)>(),
+		RepoMeshIndexCache *indexCache = NULL);
+
+	//! Converts meshes of the top level subtrees and streams them in chunks.
+	/*!
+	 * Each chunk is a world holding the path from the root node down to the 
+	 * first node with more than one child and the subtrees converted since
+	 * the previous chunk, with its own clones of their meshes. Converted 
+	 * meshes are stored in glcMeshes.
+	 */
+	static void toGLCChunks(
+		const aiScene *,
+		const QVector<GLC_Material*> &glcMaterials,
+		const QHash<const QString, GLC_3DRep*> &glcCameras,
+		const std::string &namePrefix,
+		const QVector<double> &lodErrors,
+		RepoIndexOptimizer *indexOptimizer,
+		bool compactAttributes,
+		int threadCount,
+		QVector<GLC_3DRep*> &glcMeshes,
+		const std::function<void(GLC_World &)> &chunkLoaded,
+		RepoMeshIndexCache *indexCache);
+
+	/*!
+	 * Returns a copy of the given representation with cloned geometry and
+	 * materials so that it can be handed over to another thread. Materials
+	 * are cloned once per glcMaterialClones, keyed by the originals.
+	 */
+	static GLC_3DRep* cloneGLCMesh(
+		const GLC_3DRep *glcMesh,
+		QHash<GLC_Material*, GLC_Material*> &glcMaterialClones);
+
+	//! Collects indices of the not yet converted meshes of the whole subtree.
+	static void getMeshIndices(
+		const aiNode *,
+		const QVector<GLC_3DRep*> &glcMeshes,
+		QSet<unsigned int> &meshIndices);
 
 	//! Creates a struct occurrence instance out of a given node.
 	/*!
 	 * Recursive function to create a hierarchy of occurrences of a given 
 	 * Assimp node and all of its children. Call with root node to process
 	 * the entire scene graph.
+	 *
+	 * Nodes pointing at the same list of meshes share a single struct 
+	 * reference (and hence a single 3D representation) cached in 
+	 * glcReferences, each node only gets its own instance transformation.
+	 * meshInstancesCount is incremented for every node with meshes.
 	 */
 	static GLC_StructOccurence* createOccurrenceFromNode(
 		const aiScene * scene, 
 		const aiNode * node,
 		const QVector<GLC_3DRep*> &glcMeshes,
-		const QHash<const QString, GLC_3DRep*> &glcCameras);
+		const QHash<const QString, GLC_3DRep*> &glcCameras,
+		QHash<QString, GLC_StructReference*> &glcReferences,
+		unsigned int &meshInstancesCount);
 
     //--------------------------------------------------------------------------
 	//
@@ -87,8 +160,118 @@ public:
 	static GLC_Material * toGLCMaterial(const aiMaterial *, const QHash<QString, GLC_Texture>&);
 
 	//! Returns a GLC 3DRep given an Assimp mesh and a vector of GLC Materials.
+	/*!
+	 * Meshes of at least REPO_TRANSCODER_LOD_MIN_TRIANGLES triangles get a
+	 * coarser level of detail for each of the ascending lodErrors, which are
+	 * geometric errors relative to the mesh diameter. If indexOptimizer is
+	 * set, all triangle lists are reordered for the vertex cache. If
+	 * compactAttributes is set, meshes without vertex colours store their
+	 * vertex attributes quantised, see RepoGLCMesh::setCompactAttributes().
+	 * If indexCache holds the mesh, its triangle lists are taken from there
+	 * instead, otherwise the computed ones are added to it.
+	 */
 	static GLC_3DRep* toGLCMesh(const aiMesh *, const QVector<GLC_Material*> &,
-		const std::string &namePrefix);
+		const std::string &namePrefix, 
+		const QVector<double> &lodErrors = QVector<double>(),
+		RepoIndexOptimizer *indexOptimizer = NULL,
+		bool compactAttributes = false,
+		RepoMeshIndexCache *indexCache = NULL);
+
+	/*!
+	 * Returns GLC textures keyed by name, shared through RepoTextureCache at
+	 * full resolution. Windows pick the level fit for their viewport.
+	 */
+	static QHash<QString, GLC_Texture> toGLCTextures(
+		const std::map<std::string, QImage> &,
+		int threadCount);
+
+	//--------------------------------------------------------------------------
+	//
+	// Deferred textures
+	//
+	//--------------------------------------------------------------------------
+
+	/*!
+	 * Returns 1x1 white stand-ins for the given textures. Converted with 
+	 * these, materials render with their diffuse colour straight away while
+	 * still being told apart by texture name when pooled and when the 
+	 * decoded texture is bound later on.
+	 */
+	static std::map<std::string, QImage> getPlaceholderTextures(
+		const std::vector<std::string> &names);
+
+	/*!
+	 * Returns the texture names sorted by the total size of the occurrences
+	 * using them, largest first. Occurrences covering most of the initial
+	 * fit-all view get textured first. Has to be called before the world is
+	 * handed over to the GUI thread.
+	 */
+	static std::vector<std::string> sortTexturesBySize(
+		const GLC_World &,
+		const std::vector<std::string> &names);
+
+	/*!
+	 * Decodes the textures in the given order on up to threadCount threads,
+	 * adds them to RepoTextureCache and passes the cached full resolution
+	 * image to textureLoaded, called from the decoding threads as soon as
+	 * each texture is ready. Null images are skipped.
+	 */
+	static void loadDeferredTextures(
+		const std::vector<std::string> &names,
+		const std::function<QImage(const std::string &)> &decode,
+		const std::function<void(const QString &, const QImage &)> &textureLoaded,
+		int threadCount);
+
+	//! Merges equal materials, returns the unique ones keyed by their properties.
+	/*!
+	 * Duplicates are deleted and replaced in the vector by the pooled
+	 * material. NULL entries are left untouched. Must be called before any
+	 * of the materials is attached to a mesh.
+	 */
+	static QHash<QString, GLC_Material*> poolMaterials(
+		QVector<GLC_Material*> &glcMaterials);
+
+	//! Deletes the pooled materials not used by any geometry and clears the pool.
+	/*!
+	 * Must be called before the temporary meshes are deleted.
+	 */
+	static void deleteUnusedMaterials(
+		QHash<QString, GLC_Material*> &glcMaterialsPool);
+
+	//! Returns the maximum number of conversion threads from the settings.
+	/*!
+	 * Zero (the default) means QThread::idealThreadCount().
+	 */
+	static int getThreadCount();
+
+	//! Stores the maximum number of conversion threads in the settings.
+	static void setThreadCount(int threadCount);
+
+	//! Returns true if triangles are reordered for the vertex cache (default).
+	static bool getIndexOptimization();
+
+	//! Stores whether triangles are reordered for the vertex cache.
+	static void setIndexOptimization(bool enabled);
+
+	//! Returns true if vertex attributes are stored quantised.
+	/*!
+	 * Off by default since compact meshes are drawn with a shader that
+	 * needs GLSL 1.20 and half float vertex attributes (OpenGL 3.0).
+	 */
+	static bool getCompactAttributes();
+
+	//! Stores whether vertex attributes are stored quantised.
+	static void setCompactAttributes(bool enabled);
+
+	//! Returns the relative errors of the levels of detail from the settings.
+	/*!
+	 * Defaults to 0.2%, 1% and 5% of the mesh diameter, an empty list turns
+	 * the simplification off.
+	 */
+	static QVector<double> getLodErrors();
+
+	//! Stores the relative errors of the levels of detail in the settings.
+	static void setLodErrors(const QVector<double> &lodErrors);
 
 	//! Returns a GLC Mesh given an Assimp camera.
 	static GLC_3DRep* toGLCCamera(const aiCamera *);
@@ -100,6 +283,10 @@ public:
 	static QColor toQColor(const aiColor4D &);
 
 	//! Returns a vector out of Assimp's vertices/normals/textures.
+	/*!
+	 * The returned vector is the only copy of the data, pass it to GLC 
+	 * directly so that it gets implicitly shared rather than copied again.
+	 */
 	static QVector<GLfloat> toGLCVector(
 		const aiVector3D * vertexArray, 
 		unsigned int arraySize,
@@ -111,14 +298,33 @@ public:
 		unsigned int arraySize);
 
 	//! Returns a vector of vertex indices out of Assimp faces array.
+	/*!
+	 * Meshes made of triangles only are converted in bulk. Otherwise only 
+	 * true polygons are triangulated, against a read-only view of the 
+	 * Assimp vertex array, while point and line faces are skipped.
+	 */
 	static QList<GLuint> toGLCList(
-		const QList<GLfloat> & verticesList,
+		const aiVector3D * vertexArray,
 		const aiFace * facesAarray, 
 		unsigned int size);
 
+	//! Returns true if all the faces are triangles, false otherwise.
+	static bool isTriangulated(const aiFace * facesArray, unsigned int size);
+
 	//! Returns GLC matrix out of Assimp matrix.
 	static GLC_Matrix4x4 toGLCMatrix(const aiMatrix4x4 &);
 
+	//! Returns a key identifying materials of equal properties and texture.
+	static QString getMaterialKey(const GLC_Material *);
+
+	//! Returns a key identifying the list of meshes attached to a node.
+	static QString getReferenceKey(const aiNode *);
+
+	//! Adds the size of each occurrence to the names of its textures.
+	static void getTextureSizes(
+		const GLC_StructOccurence *,
+		QHash<QString, double> &textureSizes);
+
 	//! Returns GLC point out of Assimp vector3D.
 	static GLC_Point3d toGLCPoint(const aiVector3D &);
 
@@ -133,10 +339,23 @@ public:
 	//! Replicates the meshes as new objects.
 	//static GLC_StructOccurence * deepCopyOccurence(const GLC_StructOccurence * occurence);
 
-private:
+	//--------------------------------------------------------------------------
+	//
+	// Settings
+	//
+	//--------------------------------------------------------------------------
+
+	//! Settings max conversion threads label.
+	static const QString REPO_SETTINGS_TRANSCODER_THREADS;
+
+	//! Settings levels of detail errors label.
+	static const QString REPO_SETTINGS_TRANSCODER_LOD_ERRORS;
+
+	//! Settings vertex cache optimization label.
+	static const QString REPO_SETTINGS_TRANSCODER_OPTIMIZE_INDICES;
 
-	//! GLC instance Hash table
-	//QHash<const unsigned int, GLC_StructInstance*> m_StructInstanceHash;
+	//! Settings compact vertex attributes label.
+	static const QString REPO_SETTINGS_TRANSCODER_COMPACT_ATTRIBUTES;
 
 }; // end class
 
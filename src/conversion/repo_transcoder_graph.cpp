@@ -0,0 +1,506 @@
+/**
+ *  Copyright (C) 2014 3D Repo Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "repo_transcoder_graph.h"
+#include "repo_transcoder_assimp.h"
+#include <algorithm>
+#include <climits>
+#include <iostream>
+#include <set>
+#include "../primitives/repo_memory.h"
+#include "../primitives/repo_threadpool.h"
+//------------------------------------------------------------------------------
+#include <QSettings>
+#include <QTime>
+//------------------------------------------------------------------------------
+// Core
+#include <RepoNodeCamera>
+#include <RepoNodeTexture>
+#include <RepoNodeTransformation>
+#include <RepoTranscoderString>
+//------------------------------------------------------------------------------
+
+const QString repo::gui::RepoTranscoderGraph::REPO_SETTINGS_TRANSCODER_GRAPH_BENCHMARK =
+	"RepoTranscoderGraph/benchmark";
+
+//-----------------------------------------------------------------------------
+//
+// GLC World
+//
+//-----------------------------------------------------------------------------
+GLC_World repo::gui::RepoTranscoderGraph::toGLCWorld(
+	const core::RepoGraphScene *repoScene,
+	const std::map<std::string, QImage> &textures,
+	const std::string &namePrefix)
+{
+	const int threadCount = RepoTranscoderAssimp::getThreadCount();
+
+	//-------------------------------------------------------------------------
+	// Temporary textures
+	QHash<QString, GLC_Texture> glcTextures =
+		RepoTranscoderAssimp::toGLCTextures(textures, threadCount);
+
+	//-------------------------------------------------------------------------
+	// Index materials in the order of the meshes that use them.
+	// Meshes without a material point at the extra NULL slot at the end.
+	const std::vector<core::RepoNodeAbstract *> meshes = repoScene->getMeshes();
+	QVector<const core::RepoNodeMaterial*> materials;
+	QHash<const core::RepoNodeAbstract*, int> materialIndices;
+	QVector<unsigned int> meshMaterialIndices(meshes.size());
+	for (std::vector<core::RepoNodeAbstract *>::size_type i = 0;
+		i < meshes.size(); ++i)
+	{
+		const core::RepoNodeAbstract *material =
+			getChild(meshes[i], REPO_NODE_TYPE_MATERIAL);
+		if (NULL == material)
+			meshMaterialIndices[i] = UINT_MAX;
+		else
+		{
+			if (!materialIndices.contains(material))
+			{
+				materialIndices.insert(material, materials.size());
+				materials << static_cast<const core::RepoNodeMaterial*>(material);
+			}
+			meshMaterialIndices[i] = materialIndices.value(material);
+		}
+	}
+	for (int i = 0; i < meshMaterialIndices.size(); ++i)
+		if (UINT_MAX == meshMaterialIndices[i])
+			meshMaterialIndices[i] = materials.size();
+
+	//-------------------------------------------------------------------------
+	// Allocate materials
+	QVector<GLC_Material *> glcMaterials(materials.size() + 1, NULL);
+	RepoThreadPool::parallelFor(
+		materials.size(),
+		[&](int i) {
+			glcMaterials[i] = toGLCMaterial(materials[i], glcTextures);
+		},
+		threadCount);
+
+	//-------------------------------------------------------------------------
+	// Pool equal materials
+	QHash<QString, GLC_Material*> glcMaterialsPool =
+		RepoTranscoderAssimp::poolMaterials(glcMaterials);
+
+	//-------------------------------------------------------------------------
+	// Allocate meshes
+	const QVector<double> lodErrors = RepoTranscoderAssimp::getLodErrors();
+	RepoIndexOptimizer indexOptimizer;
+	RepoIndexOptimizer *pIndexOptimizer = 
+		RepoTranscoderAssimp::getIndexOptimization() ? &indexOptimizer : NULL;
+	const bool compactAttributes = RepoTranscoderAssimp::getCompactAttributes();
+	QVector<GLC_3DRep*> glcMeshesVector(meshes.size());
+	RepoThreadPool::parallelFor(
+		meshes.size(),
+		[&](int i) {
+			glcMeshesVector[i] = toGLCMesh(
+				static_cast<const core::RepoNodeMesh*>(meshes[i]),
+				meshMaterialIndices[i],
+				glcMaterials,
+				namePrefix,
+				lodErrors,
+				pIndexOptimizer,
+				compactAttributes);
+		},
+		threadCount);
+
+	if (pIndexOptimizer)
+	{
+		std::cout << "Vertex cache ACMR of " << indexOptimizer.getTrianglesCount();
+		std::cout << " triangles: " << indexOptimizer.getACMRBefore() << " before and ";
+		std::cout << indexOptimizer.getACMRAfter() << " after reordering" << std::endl;
+	}
+
+	QHash<const core::RepoNodeAbstract*, GLC_3DRep*> glcMeshes;
+	QHash<const core::RepoNodeAbstract*, int> meshIndices;
+	for (int i = 0; i < glcMeshesVector.size(); ++i)
+	{
+		glcMeshes.insert(meshes[i], glcMeshesVector[i]);
+		meshIndices.insert(meshes[i], i);
+	}
+
+	//-------------------------------------------------------------------------
+	// Recursively build the scene graph
+	QHash<QString, GLC_StructReference*> glcReferences;
+	unsigned int meshInstancesCount = 0;
+	GLC_World world;
+	const core::RepoNodeAbstract *root = repoScene->getRoot();
+	if (root)
+	{
+		GLC_World * tempWorld = new GLC_World(
+			createOccurrenceFromNode(
+				root,
+				glcMeshes,
+				meshIndices,
+				glcReferences,
+				meshInstancesCount));
+		tempWorld->setRootName(QString::fromStdString(root->getName()));
+
+		std::cout << meshInstancesCount << " mesh instances share ";
+		std::cout << glcReferences.size() << " unique references" << std::endl;
+
+		//---------------------------------------------------------------------
+		// Clean and update positions
+		tempWorld->rootOccurence()->removeEmptyChildren();
+		tempWorld->rootOccurence()->updateChildrenAbsoluteMatrix();
+
+		world = GLC_World(*tempWorld);
+		tempWorld->clear();
+		delete tempWorld;
+	}
+
+	//-------------------------------------------------------------------------
+	// Remove only unused materials.
+	// Has to happen before the temporary meshes are deleted.
+	RepoTranscoderAssimp::deleteUnusedMaterials(glcMaterialsPool);
+	glcMaterials.clear();
+
+	//-------------------------------------------------------------------------
+	// Clean up temporary meshes
+	for (int i = 0; i < glcMeshesVector.size(); ++i)
+		delete glcMeshesVector[i];
+	glcMeshesVector.clear();
+	glcMeshes.clear();
+
+	return world;
+}
+
+GLC_StructOccurence* repo::gui::RepoTranscoderGraph::createOccurrenceFromNode(
+	const core::RepoNodeAbstract * node,
+	const QHash<const core::RepoNodeAbstract*, GLC_3DRep*> &glcMeshes,
+	const QHash<const core::RepoNodeAbstract*, int> &meshIndices,
+	QHash<QString, GLC_StructReference*> &glcReferences,
+	unsigned int &meshInstancesCount)
+{
+	Q_ASSERT (NULL != node);
+	QString name = QString::fromStdString(node->getName());
+	GLC_StructInstance* instance = NULL;
+
+	//-------------------------------------------------------------------------
+	// Sort children by type. The set of children is ordered by address, 
+	// which changes from run to run. Meshes are merged in the order of the
+	// scene meshes as indexed by the Assimp route, everything else follows
+	// the unique IDs.
+	const std::set<const core::RepoNodeAbstract*> children = node->getChildren();
+	QList<const core::RepoNodeAbstract*> meshChildren;
+	QList<const core::RepoNodeAbstract*> transformationChildren;
+	QList<const core::RepoNodeAbstract*> cameraChildren;
+	for (std::set<const core::RepoNodeAbstract*>::const_iterator it =
+		children.begin(); it != children.end(); ++it)
+	{
+		const std::string type = (*it)->getType();
+		if (REPO_NODE_TYPE_MESH == type && glcMeshes.contains(*it))
+			meshChildren << *it;
+		else if (REPO_NODE_TYPE_TRANSFORMATION == type)
+			transformationChildren << *it;
+		else if (REPO_NODE_TYPE_CAMERA == type)
+			cameraChildren << *it;
+	}
+	std::sort(meshChildren.begin(), meshChildren.end(), 
+		[&meshIndices](const core::RepoNodeAbstract *a, const core::RepoNodeAbstract *b) {
+			return meshIndices.value(a) < meshIndices.value(b);
+		});
+	std::sort(transformationChildren.begin(), transformationChildren.end(), 
+		isUniqueIDLess);
+	std::sort(cameraChildren.begin(), cameraChildren.end(), isUniqueIDLess);
+	const core::RepoNodeAbstract* camera = 
+		cameraChildren.isEmpty() ? NULL : cameraChildren.first();
+
+	// Meshes are shared by all the transformations with the same ones.
+	QString referenceKey;
+	for (int i = 0; i < meshChildren.size(); ++i)
+	{
+		if (i > 0)
+			referenceKey += ',';
+		referenceKey += QString::fromStdString(core::RepoTranscoderString::toString(
+			meshChildren[i]->getUniqueID()));
+	}
+
+	//-------------------------------------------------------------------------
+	// Meshes
+	if (!meshChildren.isEmpty())
+	{
+		++meshInstancesCount;
+		GLC_StructReference* reference = glcReferences.value(referenceKey, NULL);
+		if (NULL != reference)
+			instance = new GLC_StructInstance(reference);
+		else
+		{
+			GLC_3DRep* pRep = NULL;
+			for (int i = 0; i < meshChildren.size(); ++i)
+			{
+				GLC_3DRep * glcMesh = glcMeshes.value(meshChildren[i]);
+				if (glcMesh)
+				{
+					if (NULL == pRep)
+						pRep = new GLC_3DRep(*glcMesh);
+					else
+						pRep->merge(glcMesh);
+				}
+			}
+
+			if (NULL != pRep)
+				pRep->clean();
+			if (NULL == pRep || pRep->isEmpty())
+			{
+				std::cerr << "Empty geometry in node " << name.toStdString() << std::endl;
+				delete pRep;
+				instance = new GLC_StructInstance(new GLC_StructReference(name));
+			}
+			else
+			{
+				reference = new GLC_StructReference(pRep);
+				glcReferences.insert(referenceKey, reference);
+				instance = new GLC_StructInstance(reference);
+			}
+		}
+	}
+	else if (NULL != camera) // Camera wireframe representation
+	{
+		aiCamera assimpCamera;
+		static_cast<const core::RepoNodeCamera*>(camera)->toAssimp(&assimpCamera);
+		instance = new GLC_StructInstance(new GLC_StructReference(
+			RepoTranscoderAssimp::toGLCCamera(&assimpCamera)));
+		instance->setName(name);
+	}
+	else
+	{
+		instance = new GLC_StructInstance(new GLC_StructReference(name));
+		instance->setName(name);
+	}
+
+	//-------------------------------------------------------------------------
+	// Transformation
+	if (REPO_NODE_TYPE_TRANSFORMATION == node->getType())
+		instance->move(RepoTranscoderAssimp::toGLCMatrix(
+			static_cast<const core::RepoNodeTransformation*>(node)->getMatrix()));
+	GLC_StructOccurence* occurrence = new GLC_StructOccurence(instance);
+	occurrence->setName(name);
+
+	//-------------------------------------------------------------------------
+	// Children
+	for (int i = 0; i < transformationChildren.size(); ++i)
+		occurrence->addChild(
+			createOccurrenceFromNode(
+				transformationChildren[i],
+				glcMeshes,
+				meshIndices,
+				glcReferences,
+				meshInstancesCount));
+	return occurrence;
+}
+
+void repo::gui::RepoTranscoderGraph::benchmark(
+	const core::RepoGraphScene *repoScene,
+	const std::map<std::string, QImage> &textures)
+{
+	// Both routes run one after the other in the same process, so the peak
+	// of the second includes whatever the first one left allocated.
+	QTime time;
+	const qint64 peakBefore = RepoMemory::getPeakResidentBytes();
+	time.start();
+	GLC_World graphWorld = toGLCWorld(repoScene, textures);
+	const int graphTime = time.elapsed();
+	const qint64 graphPeak = RepoMemory::getPeakResidentBytes();
+
+	time.restart();
+	aiScene *assimpScene = new aiScene();
+	assimpScene->mFlags = 0;
+	repoScene->toAssimp(assimpScene);
+	GLC_World assimpWorld = RepoTranscoderAssimp::toGLCWorld(assimpScene, textures);
+	delete assimpScene;
+	const int assimpTime = time.elapsed();
+	const qint64 assimpPeak = RepoMemory::getPeakResidentBytes();
+
+	std::cout << "Benchmark of the scene graph conversion" << std::endl;
+	std::cout << "  direct: " << graphTime << " ms, peak resident ";
+	std::cout << RepoMemory::toMegabytes(peakBefore) << " to ";
+	std::cout << RepoMemory::toMegabytes(graphPeak) << " MB, ";
+	std::cout << graphWorld.numberOfBody() << " bodies, ";
+	std::cout << graphWorld.numberOfFaces() << " faces, ";
+	std::cout << graphWorld.numberOfVertex() << " vertices" << std::endl;
+	std::cout << "  via aiScene: " << assimpTime << " ms, peak resident ";
+	std::cout << RepoMemory::toMegabytes(graphPeak) << " to ";
+	std::cout << RepoMemory::toMegabytes(assimpPeak) << " MB, ";
+	std::cout << assimpWorld.numberOfBody() << " bodies, ";
+	std::cout << assimpWorld.numberOfFaces() << " faces, ";
+	std::cout << assimpWorld.numberOfVertex() << " vertices" << std::endl;
+	if (graphWorld.numberOfBody() != assimpWorld.numberOfBody() ||
+		graphWorld.numberOfFaces() != assimpWorld.numberOfFaces() ||
+		graphWorld.numberOfVertex() != assimpWorld.numberOfVertex())
+		std::cerr << "Scene graph conversion routes differ" << std::endl;
+	graphWorld.clear();
+	assimpWorld.clear();
+}
+
+bool repo::gui::RepoTranscoderGraph::getBenchmark()
+{
+	QSettings settings;
+	return settings.value(REPO_SETTINGS_TRANSCODER_GRAPH_BENCHMARK, false).toBool();
+}
+
+void repo::gui::RepoTranscoderGraph::setBenchmark(bool enabled)
+{
+	QSettings settings;
+	settings.setValue(REPO_SETTINGS_TRANSCODER_GRAPH_BENCHMARK, enabled);
+}
+
+//-----------------------------------------------------------------------------
+//
+// Static helpers
+//
+//-----------------------------------------------------------------------------
+
+bool repo::gui::RepoTranscoderGraph::isUniqueIDLess(
+	const core::RepoNodeAbstract *a,
+	const core::RepoNodeAbstract *b)
+{
+	return a->getUniqueID() < b->getUniqueID();
+}
+
+GLC_Material * repo::gui::RepoTranscoderGraph::toGLCMaterial(
+	const core::RepoNodeMaterial * material,
+	const QHash<QString, GLC_Texture> & glcTextures)
+{
+	// Materials are tiny, hence they go through the Assimp conversion to
+	// keep a single definition of the material properties mapping.
+	std::map<const core::RepoNodeAbstract*, std::string> texturesMapping;
+	const std::set<const core::RepoNodeAbstract*> children = material->getChildren();
+	for (std::set<const core::RepoNodeAbstract*>::const_iterator it =
+		children.begin(); it != children.end(); ++it)
+	{
+		if (REPO_NODE_TYPE_TEXTURE == (*it)->getType())
+			texturesMapping.insert(std::make_pair(*it, (*it)->getName()));
+	}
+	aiMaterial assimpMaterial;
+	material->toAssimp(texturesMapping, &assimpMaterial);
+	return RepoTranscoderAssimp::toGLCMaterial(&assimpMaterial, glcTextures);
+}
+
+GLC_3DRep* repo::gui::RepoTranscoderGraph::toGLCMesh(
+	const core::RepoNodeMesh * mesh,
+	unsigned int materialIndex,
+	const QVector<GLC_Material*>& glcMaterials,
+	const std::string &namePrefix,
+	const QVector<double> &lodErrors,
+	RepoIndexOptimizer *indexOptimizer,
+	bool compactAttributes)
+{
+	//-------------------------------------------------------------------------
+	// Assimp mesh view
+	// The arrays point straight into the node's data instead of being copied,
+	// they are detached again before the view goes out of scope.
+	aiMesh assimpMesh;
+	assimpMesh.mName = aiString(mesh->getName());
+	assimpMesh.mMaterialIndex = materialIndex;
+
+	const std::vector<aiVector3t<float> > *vertices = mesh->getVertices();
+	if (vertices && !vertices->empty())
+	{
+		assimpMesh.mNumVertices = vertices->size();
+		assimpMesh.mVertices = const_cast<aiVector3D*>(&vertices->at(0));
+	}
+
+	const std::vector<aiFace> *faces = mesh->getFaces();
+	if (faces && !faces->empty())
+	{
+		assimpMesh.mNumFaces = faces->size();
+		assimpMesh.mFaces = const_cast<aiFace*>(&faces->at(0));
+	}
+
+	const std::vector<aiVector3t<float> > *normals = mesh->getNormals();
+	if (normals && normals->size() == assimpMesh.mNumVertices && !normals->empty())
+		assimpMesh.mNormals = const_cast<aiVector3D*>(&normals->at(0));
+
+	const std::vector<aiColor4t<float> > *colors = mesh->getColors();
+	if (colors && colors->size() == assimpMesh.mNumVertices && !colors->empty())
+		assimpMesh.mColors[0] = const_cast<aiColor4D*>(&colors->at(0));
+
+	const std::vector<std::vector<aiVector3t<float> > > *uvChannels =
+		mesh->getUVChannels();
+	if (uvChannels && !uvChannels->empty() && !uvChannels->at(0).empty() &&
+		uvChannels->at(0).size() == assimpMesh.mNumVertices)
+	{
+		assimpMesh.mTextureCoords[0] =
+			const_cast<aiVector3D*>(&uvChannels->at(0).at(0));
+		assimpMesh.mNumUVComponents[0] = 2;
+	}
+
+	GLC_3DRep *glcMesh = RepoTranscoderAssimp::toGLCMesh(
+		&assimpMesh, 
+		glcMaterials, 
+		namePrefix, 
+		lodErrors, 
+		indexOptimizer, 
+		compactAttributes);
+
+	//-------------------------------------------------------------------------
+	// Detach the node's data so that aiMesh destructor does not delete it.
+	assimpMesh.mVertices = NULL;
+	assimpMesh.mNormals = NULL;
+	assimpMesh.mFaces = NULL;
+	assimpMesh.mColors[0] = NULL;
+	assimpMesh.mTextureCoords[0] = NULL;
+	assimpMesh.mNumVertices = 0;
+	assimpMesh.mNumFaces = 0;
+	return glcMesh;
+}
+
+std::map<std::string, QImage> repo::gui::RepoTranscoderGraph::getTextures(
+	const core::RepoGraphScene *repoScene)
+{
+	std::map<std::string, QImage> namedTextures;
+	std::vector<core::RepoNodeTexture*> textures = repoScene->getTextures();
+	for (unsigned int i = 0; i < textures.size(); ++i)
+	{
+		core::RepoNodeTexture* repoTex = textures[i];
+		const unsigned char* data = (unsigned char*) repoTex->getData();
+		QImage image = QImage::fromData(data, repoTex->getDataSize());
+		namedTextures.insert(std::make_pair(repoTex->getName(), image));
+	}
+	return namedTextures;
+}
+
+std::map<std::string, QByteArray> repo::gui::RepoTranscoderGraph::getRawTextures(
+	const core::RepoGraphScene *repoScene)
+{
+	std::map<std::string, QByteArray> rawTextures;
+	std::vector<core::RepoNodeTexture*> textures = repoScene->getTextures();
+	for (unsigned int i = 0; i < textures.size(); ++i)
+	{
+		core::RepoNodeTexture* repoTex = textures[i];
+		rawTextures.insert(std::make_pair(repoTex->getName(), QByteArray(
+			(const char*) repoTex->getData(), repoTex->getDataSize())));
+	}
+	return rawTextures;
+}
+
+const repo::core::RepoNodeAbstract* repo::gui::RepoTranscoderGraph::getChild(
+	const core::RepoNodeAbstract * node,
+	const std::string &type)
+{
+	const core::RepoNodeAbstract* child = NULL;
+	const std::set<const core::RepoNodeAbstract*> children = node->getChildren();
+	for (std::set<const core::RepoNodeAbstract*>::const_iterator it =
+		children.begin(); NULL == child && it != children.end(); ++it)
+	{
+		if (type == (*it)->getType())
+			child = *it;
+	}
+	return child;
+}
@@ -0,0 +1,149 @@
+/**
+ *  Copyright (C) 2014 3D Repo Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef REPO_TRANSCODER_GRAPH_H
+#define REPO_TRANSCODER_GRAPH_H
+
+//------------------------------------------------------------------------------
+#include <map>
+#include <string>
+//------------------------------------------------------------------------------
+#include <QByteArray>
+#include <QHash>
+#include <QImage>
+#include <QString>
+#include <QVector>
+//------------------------------------------------------------------------------
+#include <GLC_Material>
+#include <GLC_World>
+#include "sceneGraph/glc_structoccurence.h"
+//------------------------------------------------------------------------------
+// Core
+#include <RepoGraphScene>
+#include <RepoNodeAbstract>
+#include <RepoNodeMesh>
+#include <RepoNodeMaterial>
+//------------------------------------------------------------------------------
+#include "../primitives/repo_indexoptimizer.h"
+//------------------------------------------------------------------------------
+
+namespace repo {
+namespace gui {
+
+/*!
+ * Creates GLC_World instance straight out of a 3D Repo scene graph without
+ * converting it into an intermediary Assimp aiScene first. Mesh data is read
+ * in place from the scene nodes and goes through the same conversion as in
+ * RepoTranscoderAssimp, hence the resulting world is the same.
+ */
+class RepoTranscoderGraph
+{
+
+public:
+
+	//! Creates a world instance of a given scene graph.
+	/*!
+	 * Materials and meshes are converted in parallel on up to
+	 * RepoTranscoderAssimp::getThreadCount() threads.
+	 */
+	static GLC_World toGLCWorld(
+		const core::RepoGraphScene *,
+		const std::map<std::string, QImage> &,
+		const std::string & namePrefix = "");
+
+	//! Creates a struct occurrence instance out of a given transformation.
+	/*!
+	 * Recursive function to create a hierarchy of occurrences of a given
+	 * transformation node and all of its transformation children. Mesh
+	 * children make up the 3D representation of the occurrence, merged in 
+	 * the order of meshIndices, which is shared via glcReferences by all 
+	 * transformations with the same meshes. Children follow their unique IDs.
+	 */
+	static GLC_StructOccurence* createOccurrenceFromNode(
+		const core::RepoNodeAbstract * node,
+		const QHash<const core::RepoNodeAbstract*, GLC_3DRep*> &glcMeshes,
+		const QHash<const core::RepoNodeAbstract*, int> &meshIndices,
+		QHash<QString, GLC_StructReference*> &glcReferences,
+		unsigned int &meshInstancesCount);
+
+	/*!
+	 * Converts the scene graph both directly and via an Assimp aiScene and
+	 * logs time, peak resident memory and size of both worlds.
+	 */
+	static void benchmark(
+		const core::RepoGraphScene *,
+		const std::map<std::string, QImage> &);
+
+	//! Returns true if fetched revisions are converted both ways to compare.
+	static bool getBenchmark();
+
+	//! Sets whether fetched revisions are converted both ways to compare.
+	static void setBenchmark(bool enabled);
+
+    //--------------------------------------------------------------------------
+	//
+	// Static helpers
+	//
+    //--------------------------------------------------------------------------
+
+	//! Returns a GLC Material given a 3D Repo material and its textures.
+	static GLC_Material * toGLCMaterial(
+		const core::RepoNodeMaterial *,
+		const QHash<QString, GLC_Texture> &);
+
+	//! Returns a GLC 3DRep given a 3D Repo mesh and an index into materials.
+	static GLC_3DRep* toGLCMesh(
+		const core::RepoNodeMesh *,
+		unsigned int materialIndex,
+		const QVector<GLC_Material*> &,
+		const std::string &namePrefix,
+		const QVector<double> &lodErrors = QVector<double>(),
+		RepoIndexOptimizer *indexOptimizer = NULL,
+		bool compactAttributes = false);
+
+	//! Returns the decoded texture images of a scene graph keyed by name.
+	static std::map<std::string, QImage> getTextures(
+		const core::RepoGraphScene *);
+
+	/*!
+	 * Returns copies of the encoded texture files of a scene graph keyed by
+	 * name, to be decoded after the scene graph has been handed over.
+	 */
+	static std::map<std::string, QByteArray> getRawTextures(
+		const core::RepoGraphScene *);
+
+	//! Returns the first child of a given type, NULL if there is none.
+	static const core::RepoNodeAbstract* getChild(
+		const core::RepoNodeAbstract *,
+		const std::string &type);
+
+	//! Orders nodes by their unique IDs.
+	static bool isUniqueIDLess(
+		const core::RepoNodeAbstract *a,
+		const core::RepoNodeAbstract *b);
+
+public :
+
+	//! Settings conversion benchmark label.
+	static const QString REPO_SETTINGS_TRANSCODER_GRAPH_BENCHMARK;
+
+}; // end class
+
+} // end namespace gui
+} // end namespace repo
+
+#endif // end REPO_TRANSCODER_GRAPH_H
@@ -0,0 +1,201 @@
+/**
+ *  Copyright (C) 2014 3D Repo Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "repo_transcoder_kernels.h"
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#define REPO_TRANSCODER_SSE2
+	#include <emmintrin.h>
+	#if defined(_MSC_VER)
+		#include <intrin.h>
+	#endif
+#endif
+
+namespace {
+
+//------------------------------------------------------------------------------
+//
+// Scalar kernels
+//
+//------------------------------------------------------------------------------
+
+void packXYScalar(const float *xyz, float *xy, unsigned int count)
+{
+	for (unsigned int i = 0; i < count; ++i)
+	{
+		xy[2 * i + 0] = xyz[3 * i + 0];
+		xy[2 * i + 1] = xyz[3 * i + 1];
+	}
+}
+
+void packXScalar(const float *xyz, float *x, unsigned int count)
+{
+	for (unsigned int i = 0; i < count; ++i)
+		x[i] = xyz[3 * i];
+}
+
+void transpose4x4Scalar(const float *rowMajor, double *columnMajor)
+{
+	for (int row = 0; row < 4; ++row)
+		for (int column = 0; column < 4; ++column)
+			columnMajor[column * 4 + row] = rowMajor[row * 4 + column];
+}
+
+#ifdef REPO_TRANSCODER_SSE2
+//------------------------------------------------------------------------------
+//
+// SSE2 kernels
+//
+//------------------------------------------------------------------------------
+
+// Four [x,y,z] triplets are loaded as three registers at a time:
+// a = x0 y0 z0 x1, b = y1 z1 x2 y2, c = z2 x3 y3 z3
+void packXYSSE2(const float *xyz, float *xy, unsigned int count)
+{
+	unsigned int i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		const __m128 a = _mm_loadu_ps(xyz + 3 * i + 0);
+		const __m128 b = _mm_loadu_ps(xyz + 3 * i + 4);
+		const __m128 c = _mm_loadu_ps(xyz + 3 * i + 8);
+		const __m128 t = _mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 3, 3)); // x1 x1 y1 y1
+		_mm_storeu_ps(xy + 2 * i + 0, _mm_shuffle_ps(a, t, _MM_SHUFFLE(2, 0, 1, 0)));
+		_mm_storeu_ps(xy + 2 * i + 4, _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 1, 3, 2)));
+	}
+	packXYScalar(xyz + 3 * i, xy + 2 * i, count - i);
+}
+
+void packXSSE2(const float *xyz, float *x, unsigned int count)
+{
+	unsigned int i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		const __m128 a = _mm_loadu_ps(xyz + 3 * i + 0);
+		const __m128 b = _mm_loadu_ps(xyz + 3 * i + 4);
+		const __m128 c = _mm_loadu_ps(xyz + 3 * i + 8);
+		const __m128 u = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 3, 3, 0)); // x0 x1 .. ..
+		const __m128 t = _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 1, 2, 2)); // x2 x2 x3 x3
+		_mm_storeu_ps(x + i, _mm_shuffle_ps(u, t, _MM_SHUFFLE(2, 0, 1, 0)));
+	}
+	packXScalar(xyz + 3 * i, x + i, count - i);
+}
+
+void transpose4x4SSE2(const float *rowMajor, double *columnMajor)
+{
+	__m128 r0 = _mm_loadu_ps(rowMajor + 0);
+	__m128 r1 = _mm_loadu_ps(rowMajor + 4);
+	__m128 r2 = _mm_loadu_ps(rowMajor + 8);
+	__m128 r3 = _mm_loadu_ps(rowMajor + 12);
+	_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+	_mm_storeu_pd(columnMajor + 0, _mm_cvtps_pd(r0));
+	_mm_storeu_pd(columnMajor + 2, _mm_cvtps_pd(_mm_movehl_ps(r0, r0)));
+	_mm_storeu_pd(columnMajor + 4, _mm_cvtps_pd(r1));
+	_mm_storeu_pd(columnMajor + 6, _mm_cvtps_pd(_mm_movehl_ps(r1, r1)));
+	_mm_storeu_pd(columnMajor + 8, _mm_cvtps_pd(r2));
+	_mm_storeu_pd(columnMajor + 10, _mm_cvtps_pd(_mm_movehl_ps(r2, r2)));
+	_mm_storeu_pd(columnMajor + 12, _mm_cvtps_pd(r3));
+	_mm_storeu_pd(columnMajor + 14, _mm_cvtps_pd(_mm_movehl_ps(r3, r3)));
+}
+
+//! Returns true if the CPU executing this process supports SSE2.
+bool isSSE2Supported()
+{
+#if defined(_M_X64) || defined(__x86_64__)
+	return true; // part of the x86-64 baseline
+#elif defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 1);
+	return 0 != (info[3] & (1 << 26));
+#else
+	return __builtin_cpu_supports("sse2");
+#endif
+}
+#endif // REPO_TRANSCODER_SSE2
+
+//------------------------------------------------------------------------------
+//
+// Runtime dispatch
+//
+//------------------------------------------------------------------------------
+
+struct RepoKernels
+{
+	void (*packXY)(const float *, float *, unsigned int);
+	void (*packX)(const float *, float *, unsigned int);
+	void (*transpose4x4)(const float *, double *);
+	const char *name;
+};
+
+RepoKernels selectKernels()
+{
+	RepoKernels kernels = { packXYScalar, packXScalar, transpose4x4Scalar, "scalar" };
+#ifdef REPO_TRANSCODER_SSE2
+	if (isSSE2Supported())
+	{
+		RepoKernels sse2 = { packXYSSE2, packXSSE2, transpose4x4SSE2, "SSE2" };
+		kernels = sse2;
+	}
+#endif
+	return kernels;
+}
+
+const RepoKernels &getKernels()
+{
+	static const RepoKernels kernels = selectKernels();
+	return kernels;
+}
+
+} // end namespace
+
+void repo::gui::RepoTranscoderKernels::packXY(
+	const float *xyz,
+	float *xy,
+	unsigned int count)
+{
+	getKernels().packXY(xyz, xy, count);
+}
+
+void repo::gui::RepoTranscoderKernels::packX(
+	const float *xyz,
+	float *x,
+	unsigned int count)
+{
+	getKernels().packX(xyz, x, count);
+}
+
+void repo::gui::RepoTranscoderKernels::copyRGBA(
+	const float *src,
+	float *dst,
+	unsigned int count)
+{
+	// Layouts are identical, the library block copy is already vectorised.
+	if (count > 0)
+		memcpy(dst, src, count * 4 * sizeof(float));
+}
+
+void repo::gui::RepoTranscoderKernels::transpose4x4(
+	const float *rowMajor,
+	double *columnMajor)
+{
+	getKernels().transpose4x4(rowMajor, columnMajor);
+}
+
+QString repo::gui::RepoTranscoderKernels::getKernelsName()
+{
+	return QString(getKernels().name);
+}
@@ -0,0 +1,58 @@
+/**
+ *  Copyright (C) 2014 3D Repo Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef REPO_TRANSCODER_KERNELS_H
+#define REPO_TRANSCODER_KERNELS_H
+
+//------------------------------------------------------------------------------
+#include <QString>
+//------------------------------------------------------------------------------
+
+namespace repo {
+namespace gui {
+
+/*!
+ * Bulk conversion kernels used by the Assimp transcoder. Each kernel has a
+ * scalar and an SSE2 implementation, the latter is picked once at runtime if
+ * the CPU supports it. All source arrays are tightly packed floats.
+ */
+class RepoTranscoderKernels
+{
+
+public :
+
+	//! Copies x, y out of count packed [x,y,z] triplets, eg UV texels.
+	static void packXY(const float *xyz, float *xy, unsigned int count);
+
+	//! Copies x out of count packed [x,y,z] triplets, eg U texels.
+	static void packX(const float *xyz, float *x, unsigned int count);
+
+	//! Copies count packed [r,g,b,a] colours.
+	static void copyRGBA(const float *src, float *dst, unsigned int count);
+
+	//! Transposes a row-major 4x4 float matrix into a column-major double one.
+	static void transpose4x4(const float *rowMajor, double *columnMajor);
+
+	//! Returns the name of the kernels selected for this CPU.
+	static QString getKernelsName();
+
+}; // end class
+
+} // end namespace gui
+} // end namespace repo
+
+#endif // end REPO_TRANSCODER_KERNELS_H
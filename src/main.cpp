@@ -16,18 +16,27 @@
  */
 
 #include "repogui.h"
+#include "workers/repo_batchimport.h"
 #include <QApplication>
 #include <QResource>
 
 int main(int argc, char *argv[])
 {
-    QApplication a(argc, argv);
-
     QCoreApplication::setOrganizationName("3D Repo");
     QCoreApplication::setOrganizationDomain("3drepo.org");
     QCoreApplication::setApplicationName("3D Repo GUI");
     QCoreApplication::setApplicationVersion("0.0.1");
 
+    //--------------------------------------------------------------------------
+    // Headless batch import needs no display at all.
+    if (repo::gui::RepoBatchImport::isBatch(argc, argv))
+    {
+        QCoreApplication a(argc, argv);
+        return repo::gui::RepoBatchImport::exec(a.arguments());
+    }
+
+    QApplication a(argc, argv);
+
     repo::gui::RepoGUI w;
     w.show();
     w.startup();
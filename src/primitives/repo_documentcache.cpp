@@ -0,0 +1,212 @@
+/**
+ *  Copyright (C) 2014 3D Repo Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "repo_documentcache.h"
+//------------------------------------------------------------------------------
+#include <iostream>
+//------------------------------------------------------------------------------
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QMap>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QtEndian>
+//------------------------------------------------------------------------------
+// Core
+#include <RepoNodeAbstract>
+//------------------------------------------------------------------------------
+
+const QString repo::gui::RepoDocumentCache::REPO_SETTINGS_DOCUMENT_CACHE_MAX_SIZE =
+	"RepoDocumentCache/maxSize";
+
+//! Seconds after which a used document is marked as recently used again.
+static const int REPO_DOCUMENT_CACHE_TOUCH_INTERVAL = 3600;
+
+//! Guards the index shared by workers fetching revisions at the same time.
+static QMutex indexMutex;
+
+repo::gui::RepoDocumentCache::RepoDocumentCache()
+	: directory(QStandardPaths::writableLocation(QStandardPaths::CacheLocation)
+		+ "/documents")
+	, maxSize(qMax(0, getMaxSize()))
+{
+	QDir().mkpath(directory);
+}
+
+mongo::BSONArray repo::gui::RepoDocumentCache::load(
+	const std::string &database,
+	const mongo::BSONArray &ids,
+	const std::function<void(const mongo::BSONObj &)> &consume,
+	qint64 *bytes)
+{
+	if (0 == maxSize)
+		return ids;
+
+	mongo::BSONArrayBuilder missing;
+	const QDateTime touchTime = 
+		QDateTime::currentDateTime().addSecs(-REPO_DOCUMENT_CACHE_TOUCH_INTERVAL);
+	mongo::BSONObjIterator it(ids);
+	while (it.more())
+	{
+		const mongo::BSONElement id = it.next();
+		QFile file(getEntryPath(database, id));
+		QByteArray data;
+		if (file.open(QIODevice::ReadOnly))
+			data = file.readAll();
+
+		//----------------------------------------------------------------------
+		// A valid entry is a single BSON document starting with its own 
+		// little-endian 32 bit size.
+		if (data.size() < 5 || data.size() != 
+			qFromLittleEndian<qint32>((const uchar *) data.constData()))
+		{
+			if (!data.isEmpty())
+			{
+				file.close();
+				file.remove();
+			}
+			missing.append(id);
+			continue;
+		}
+		consume(mongo::BSONObj(data.constData()).getOwned());
+		if (bytes)
+			*bytes += data.size();
+
+		// Rewriting the first byte refreshes the modification time.
+		if (QFileInfo(file).lastModified() < touchTime)
+		{
+			file.close();
+			if (file.open(QIODevice::ReadWrite))
+				file.write(data.constData(), 1);
+		}
+	}
+	return missing.arr();
+}
+
+void repo::gui::RepoDocumentCache::store(
+	const std::string &database,
+	const std::vector<mongo::BSONObj> &documents,
+	size_t from)
+{
+	if (0 == maxSize || from >= documents.size())
+		return;
+
+	//--------------------------------------------------------------------------
+	// Written to a temporary file first so that a half written document 
+	// never replaces a valid one.
+	qint64 bytes = 0;
+	for (size_t i = from; i < documents.size(); ++i)
+	{
+		const mongo::BSONElement id = documents[i].getField(REPO_NODE_LABEL_ID);
+		if (id.eoo())
+			continue;
+		const QString path = getEntryPath(database, id);
+		if (QFile::exists(path))
+			continue;
+		QDir().mkpath(QFileInfo(path).absolutePath());
+		QSaveFile file(path);
+		if (file.open(QIODevice::WriteOnly))
+		{
+			file.write(documents[i].objdata(), documents[i].objsize());
+			if (file.commit())
+				bytes += documents[i].objsize();
+		}
+	}
+
+	QMutexLocker locker(&indexMutex);
+	QSettings index(directory + "/index.ini", QSettings::IniFormat);
+	index.setValue("bytes", index.value("bytes").toLongLong() + bytes);
+	evict(index);
+}
+
+void repo::gui::RepoDocumentCache::clear()
+{
+	QMutexLocker locker(&indexMutex);
+	QDir dir(directory);
+	dir.removeRecursively();
+	QDir().mkpath(directory);
+}
+
+qint64 repo::gui::RepoDocumentCache::getSize()
+{
+	QMutexLocker locker(&indexMutex);
+	QSettings index(directory + "/index.ini", QSettings::IniFormat);
+	return index.value("bytes").toLongLong();
+}
+
+int repo::gui::RepoDocumentCache::getMaxSize()
+{
+	QSettings settings;
+	return settings.value(
+		REPO_SETTINGS_DOCUMENT_CACHE_MAX_SIZE,
+		REPO_DOCUMENT_CACHE_DEFAULT_MAX_SIZE).toInt();
+}
+
+void repo::gui::RepoDocumentCache::setMaxSize(int megabytes)
+{
+	QSettings settings;
+	settings.setValue(REPO_SETTINGS_DOCUMENT_CACHE_MAX_SIZE, megabytes);
+}
+
+QString repo::gui::RepoDocumentCache::getEntryPath(
+	const std::string &database,
+	const mongo::BSONElement &id) const
+{
+	// Unique IDs are binary UUIDs, sharded by their first byte so that no 
+	// single directory holds too many files.
+	int length = 0;
+	const char *bytes = id.binData(length);
+	const QString hex = QByteArray(bytes, length).toHex();
+	return directory + "/" + QString::fromStdString(database) + "/" + 
+		hex.left(2) + "/" + hex + ".bson";
+}
+
+void repo::gui::RepoDocumentCache::evict(QSettings &index)
+{
+	const qint64 maxBytes = (qint64) maxSize * 1024 * 1024;
+	if (index.value("bytes").toLongLong() <= maxBytes)
+		return;
+
+	//--------------------------------------------------------------------------
+	// Documents sorted from the least recently used one. Evicted down to 90%
+	// of the limit so that the scan does not repeat with every fetch.
+	QMultiMap<QDateTime, QString> entries;
+	qint64 bytes = 0;
+	QDirIterator it(directory, QStringList("*.bson"), QDir::Files, 
+		QDirIterator::Subdirectories);
+	while (it.hasNext())
+	{
+		it.next();
+		entries.insert(it.fileInfo().lastModified(), it.filePath());
+		bytes += it.fileInfo().size();
+	}
+
+	QMultiMap<QDateTime, QString>::const_iterator entry = entries.constBegin();
+	for (; bytes > maxBytes * 9 / 10 && entry != entries.constEnd(); ++entry)
+	{
+		bytes -= QFileInfo(entry.value()).size();
+		QFile::remove(entry.value());
+	}
+	index.setValue("bytes", bytes);
+	std::cout << "Document cache evicted to " << bytes / (1024 * 1024);
+	std::cout << " MB" << std::endl;
+}
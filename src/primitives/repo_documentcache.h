@@ -0,0 +1,114 @@
+/**
+ *  Copyright (C) 2014 3D Repo Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef REPO_DOCUMENT_CACHE_H
+#define REPO_DOCUMENT_CACHE_H
+
+//------------------------------------------------------------------------------
+#include <functional>
+#include <string>
+#include <vector>
+//------------------------------------------------------------------------------
+#include <QString>
+#include <QSettings>
+//------------------------------------------------------------------------------
+#include "mongoclientwrapper.h"
+//------------------------------------------------------------------------------
+
+namespace repo {
+namespace gui {
+
+/*!
+ * Persistent on-disk cache of scene documents fetched from the database,
+ * stored under the user cache directory. Scene documents never change once
+ * committed as they are addressed by their unique IDs, hence each one is
+ * stored as is in its own BSON file keyed by database and unique ID and is
+ * shared by all the revisions that contain it. Files are evicted in least
+ * recently used order above a size limit, the time of use being the file
+ * modification time which is refreshed at most once per hour.
+ */
+class RepoDocumentCache
+{
+
+public :
+
+	static const QString REPO_SETTINGS_DOCUMENT_CACHE_MAX_SIZE;
+
+	//! Default size limit of the cache in megabytes.
+	static const int REPO_DOCUMENT_CACHE_DEFAULT_MAX_SIZE = 4096;
+
+public :
+
+	//! Creates a cache in the default user cache location.
+	RepoDocumentCache();
+
+	/*!
+	 * Passes the cached documents of the given unique IDs one by one to
+	 * consume and returns the IDs that are not cached. The size of the
+	 * documents read from the cache is added to bytes if given.
+	 */
+	mongo::BSONArray load(
+		const std::string &database,
+		const mongo::BSONArray &ids,
+		const std::function<void(const mongo::BSONObj &)> &consume,
+		qint64 *bytes = NULL);
+
+	/*!
+	 * Stores the documents from the given index on, which have to be
+	 * complete, ie not fetched with a projection.
+	 */
+	void store(
+		const std::string &database,
+		const std::vector<mongo::BSONObj> &documents,
+		size_t from = 0);
+
+	//! Removes all documents from the cache.
+	void clear();
+
+	//! Returns the size of all documents in bytes.
+	qint64 getSize();
+
+	//! Returns the size limit of the cache in megabytes, 0 disables caching.
+	static int getMaxSize();
+
+	//! Sets the size limit of the cache in megabytes, 0 disables caching.
+	static void setMaxSize(int megabytes);
+
+private :
+
+	//! Returns the full path of the file of the given unique ID.
+	QString getEntryPath(
+		const std::string &database,
+		const mongo::BSONElement &id) const;
+
+	//! Removes least recently used documents until the cache fits its limit.
+	void evict(QSettings &index);
+
+private :
+
+	//! Directory holding the documents and the index.
+	QString directory;
+
+	//! Size limit in megabytes.
+	int maxSize;
+
+}; // end class
+
+} // end namespace gui
+} // end namespace repo
+
+#endif // end REPO_DOCUMENT_CACHE_H
@@ -0,0 +1,604 @@
+/**
+ *  Copyright (C) 2014 3D Repo Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "repo_glcmesh.h"
+//------------------------------------------------------------------------------
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+//------------------------------------------------------------------------------
+#include <QHash>
+#include <QOpenGLContext>
+#include <QOpenGLFunctions>
+#include <QSet>
+//------------------------------------------------------------------------------
+#include <glc_state.h>
+#include "shading/glc_selectionmaterial.h"
+
+#ifndef GL_HALF_FLOAT
+#define GL_HALF_FLOAT 0x140B
+#endif
+
+//! Layout of a compact vertex, 16 bytes.
+struct RepoCompactVertex
+{
+	qint16 position[4]; //!< x, y, z quantised within the bounding box, padding
+	qint16 normal[2]; //!< oct encoded unit normal
+	quint16 texel[2]; //!< u, v half floats
+};
+
+//! Returns a float in [-1, 1] as a normalised 16 bit integer.
+static inline qint16 toSnorm16(float value)
+{
+	value = std::max(-1.0f, std::min(1.0f, value));
+	return (qint16) std::floor(value * 32767.0f + 0.5f);
+}
+
+//! Returns a float as IEEE 754 half float, rounded to nearest.
+static inline quint16 toHalf(float value)
+{
+	quint32 bits;
+	memcpy(&bits, &value, sizeof(bits));
+	const quint32 sign = (bits >> 16) & 0x8000;
+	const int exponent = (int) ((bits >> 23) & 0xFF) - 127 + 15;
+	quint32 mantissa = bits & 0x7FFFFF;
+	if (((bits >> 23) & 0xFF) == 0xFF) // infinity or NaN
+		return (quint16) (sign | 0x7C00 | (mantissa ? 0x200 : 0));
+	if (exponent >= 31) // overflow
+		return (quint16) (sign | 0x7C00);
+	if (exponent <= 0) // subnormal or zero
+	{
+		if (exponent < -10)
+			return (quint16) sign;
+		mantissa |= 0x800000;
+		const int shift = 14 - exponent;
+		return (quint16) (sign | ((mantissa + (1 << (shift - 1))) >> shift));
+	}
+	// Rounding may carry into the exponent, which is the correct result.
+	return (quint16) (sign + (((quint32) exponent << 10) | (mantissa >> 13))
+		+ ((mantissa >> 12) & 1));
+}
+
+//! Encodes a unit normal into two normalised 16 bit integers.
+static inline void toOctahedron(const GLfloat *normal, qint16 *result)
+{
+	float x = normal[0];
+	float y = normal[1];
+	const float z = normal[2];
+	const float length = std::fabs(x) + std::fabs(y) + std::fabs(z);
+	if (length <= 0.0f)
+	{
+		result[0] = result[1] = 0;
+		return;
+	}
+	x /= length;
+	y /= length;
+	if (z < 0.0f)
+	{
+		const float ox = (1.0f - std::fabs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+		const float oy = (1.0f - std::fabs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+		x = ox;
+		y = oy;
+	}
+	result[0] = toSnorm16(x);
+	result[1] = toSnorm16(y);
+}
+
+//! Vertex shader decoding compact attributes.
+static const char REPO_COMPACT_VERTEX_SHADER[] =
+	"#version 120\n"
+	"attribute vec3 position;\n"
+	"attribute vec2 octNormal;\n"
+	"attribute vec2 texel;\n"
+	"uniform vec3 positionOffset;\n"
+	"uniform vec3 positionScale;\n"
+	"varying vec3 eyeNormal;\n"
+	"varying vec3 eyePosition;\n"
+	"varying vec2 texCoord;\n"
+	"vec3 octDecode(vec2 e)\n"
+	"{\n"
+	"	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));\n"
+	"	if (n.z < 0.0)\n"
+	"		n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);\n"
+	"	return normalize(n);\n"
+	"}\n"
+	"void main()\n"
+	"{\n"
+	"	vec4 p = vec4(positionOffset + positionScale * position, 1.0);\n"
+	"	eyePosition = vec3(gl_ModelViewMatrix * p);\n"
+	"	eyeNormal = gl_NormalMatrix * octDecode(octNormal);\n"
+	"	texCoord = texel;\n"
+	"	gl_FrontColor = gl_Color;\n"
+	"	gl_Position = gl_ModelViewProjectionMatrix * p;\n"
+	"}\n";
+
+//! Fragment shader lighting compact meshes like the fixed pipeline does.
+static const char REPO_COMPACT_FRAGMENT_SHADER[] =
+	"#version 120\n"
+	"uniform bool isSelectionMode;\n"
+	"uniform bool hasTexture;\n"
+	"uniform sampler2D textureSampler;\n"
+	"varying vec3 eyeNormal;\n"
+	"varying vec3 eyePosition;\n"
+	"varying vec2 texCoord;\n"
+	"void main()\n"
+	"{\n"
+	"	if (isSelectionMode)\n"
+	"	{\n"
+	"		gl_FragColor = gl_Color;\n"
+	"		return;\n"
+	"	}\n"
+	"	vec3 n = normalize(gl_FrontFacing ? eyeNormal : -eyeNormal);\n"
+	"	vec3 l = normalize(gl_LightSource[0].position.xyz - eyePosition * gl_LightSource[0].position.w);\n"
+	"	vec3 h = normalize(l + normalize(-eyePosition));\n"
+	"	vec4 diffuse = gl_FrontMaterial.diffuse;\n"
+	"	if (hasTexture)\n"
+	"		diffuse *= texture2D(textureSampler, texCoord);\n"
+	"	float lambert = max(dot(n, l), 0.0);\n"
+	"	vec4 color = gl_FrontLightModelProduct.sceneColor\n"
+	"		+ gl_FrontMaterial.ambient * gl_LightSource[0].ambient\n"
+	"		+ diffuse * gl_LightSource[0].diffuse * lambert;\n"
+	"	if (lambert > 0.0)\n"
+	"		color += gl_FrontMaterial.specular * gl_LightSource[0].specular\n"
+	"			* pow(max(dot(n, h), 0.0), gl_FrontMaterial.shininess);\n"
+	"	gl_FragColor = vec4(color.rgb, diffuse.a);\n"
+	"}\n";
+
+double repo::gui::RepoGLCMesh::lodPixelCullingRatio = 100.0;
+int repo::gui::RepoGLCMesh::lodViewportSize = 1000;
+double repo::gui::RepoGLCMesh::lodPixelError = 1.0;
+
+repo::gui::RepoGLCMesh::RepoGLCMesh()
+	: GLC_Mesh()
+	, isPolygonWireframeCreated(false)
+	, currentLod(0)
+	, isCompact(false)
+	, compactVerticesCount(0)
+	, vertexBuffer(QGLBuffer::VertexBuffer)
+	, indexBuffer(QGLBuffer::IndexBuffer)
+{
+	for (int i = 0; i < 3; ++i)
+	{
+		compactOffset[i] = 0.0f;
+		compactScale[i] = 1.0f;
+	}
+}
+
+repo::gui::RepoGLCMesh::RepoGLCMesh(const RepoGLCMesh &other)
+	: GLC_Mesh(other)
+	, outlineIndices(other.outlineIndices)
+	, outlineSizes(other.outlineSizes)
+	, isPolygonWireframeCreated(other.isPolygonWireframeCreated)
+	, lodErrors(other.lodErrors)
+	, currentLod(other.currentLod)
+	, isCompact(other.isCompact)
+	, compactVerticesCount(other.compactVerticesCount)
+	, compactVertices(other.compactVertices)
+	, compactBoundingBox(other.compactBoundingBox)
+	, compactGroups(other.compactGroups)
+	, vertexBuffer(other.vertexBuffer)
+	, indexBuffer(other.indexBuffer)
+{
+	for (int i = 0; i < 3; ++i)
+	{
+		compactOffset[i] = other.compactOffset[i];
+		compactScale[i] = other.compactScale[i];
+	}
+}
+
+repo::gui::RepoGLCMesh::~RepoGLCMesh() {}
+
+GLC_Geometry* repo::gui::RepoGLCMesh::clone() const
+{
+	return new RepoGLCMesh(*this);
+}
+
+void repo::gui::RepoGLCMesh::setPolygonOutlines(
+	const QVector<GLuint> &outlineIndices,
+	const QVector<GLuint> &outlineSizes)
+{
+	this->outlineIndices = outlineIndices;
+	this->outlineSizes = outlineSizes;
+}
+
+QVector<GLuint> repo::gui::RepoGLCMesh::getPolygonEdges() const
+{
+	QVector<GLuint> edges;
+	QSet<quint64> uniqueEdges;
+
+	//--------------------------------------------------------------------------
+	// Closed loops, either the original polygons or the triangles.
+	QVector<GLuint> loopIndices = outlineIndices;
+	QVector<GLuint> loopSizes = outlineSizes;
+	if (loopSizes.isEmpty())
+	{
+		QList<GLC_uint> materials = materialIds();
+		for (int i = 0; i < materials.size(); ++i)
+			if (containsTriangles(0, materials[i]))
+				loopIndices += getEquivalentTrianglesStripsFansIndex(0, materials[i]);
+		loopSizes.fill(3, loopIndices.size() / 3);
+	}
+
+	//--------------------------------------------------------------------------
+	// Undirected edges, each stored once as (min, max).
+	uniqueEdges.reserve(loopIndices.size());
+	edges.reserve(loopIndices.size() * 2);
+	int offset = 0;
+	for (int i = 0; i < loopSizes.size(); ++i)
+	{
+		const int size = loopSizes[i];
+		for (int j = 0; j < size; ++j)
+		{
+			GLuint a = loopIndices[offset + j];
+			GLuint b = loopIndices[offset + (j + 1) % size];
+			if (a > b)
+				std::swap(a, b);
+			const quint64 key = ((quint64) a << 32) | b;
+			if (a != b && !uniqueEdges.contains(key))
+			{
+				uniqueEdges.insert(key);
+				edges << a << b;
+			}
+		}
+		offset += size;
+	}
+	return edges;
+}
+
+void repo::gui::RepoGLCMesh::createPolygonWireframe()
+{
+	if (isPolygonWireframeCreated)
+		return;
+	isPolygonWireframeCreated = true;
+
+	const QVector<GLuint> edges = getPolygonEdges();
+	const GLfloatVector positions = getPositions();
+	if (edges.isEmpty() || positions.isEmpty())
+		return;
+
+	//--------------------------------------------------------------------------
+	// Vertex to incident edges adjacency
+	const int edgesCount = edges.size() / 2;
+	QMultiHash<GLuint, int> incidentEdges;
+	incidentEdges.reserve(edges.size());
+	for (int i = 0; i < edgesCount; ++i)
+	{
+		incidentEdges.insert(edges[2 * i], i);
+		incidentEdges.insert(edges[2 * i + 1], i);
+	}
+
+	//--------------------------------------------------------------------------
+	// Chain the edges into line strips so that each edge is drawn exactly
+	// once using as few vertex groups as possible.
+	QVector<bool> isUsed(edgesCount, false);
+	GLfloatVector strip;
+	for (int i = 0; i < edgesCount; ++i)
+	{
+		if (isUsed[i])
+			continue;
+		isUsed[i] = true;
+
+		GLuint vertex = edges[2 * i + 1];
+		strip.clear();
+		for (int k = 0; k < 3; ++k)
+			strip << positions[3 * edges[2 * i] + k];
+		for (int k = 0; k < 3; ++k)
+			strip << positions[3 * vertex + k];
+
+		bool isExtended = true;
+		while (isExtended)
+		{
+			isExtended = false;
+			QMultiHash<GLuint, int>::const_iterator it = incidentEdges.find(vertex);
+			for (; !isExtended && it != incidentEdges.end() && it.key() == vertex; ++it)
+			{
+				const int edge = it.value();
+				if (!isUsed[edge])
+				{
+					isUsed[edge] = true;
+					vertex = (edges[2 * edge] == vertex)
+						? edges[2 * edge + 1]
+						: edges[2 * edge];
+					for (int k = 0; k < 3; ++k)
+						strip << positions[3 * vertex + k];
+					isExtended = true;
+				}
+			}
+		}
+		addVerticeGroup(strip);
+	}
+}
+
+void repo::gui::RepoGLCMesh::addLod(
+	GLC_Material *material,
+	const QList<GLuint> &triangles,
+	double relativeError)
+{
+	lodErrors << relativeError;
+	addTriangles(material, triangles, lodErrors.size(), relativeError);
+}
+
+void repo::gui::RepoGLCMesh::setCurrentLod(const int value)
+{
+	if (lodErrors.isEmpty() || value <= 0)
+	{
+		currentLod = 0;
+		GLC_Mesh::setCurrentLod(value);
+		return;
+	}
+
+	//--------------------------------------------------------------------------
+	// Projected size of the mesh bounding sphere in pixels.
+	const double coverage = 
+		std::max(0.0, lodPixelCullingRatio - value) / 100.0;
+	const double diameterPixels = coverage * lodViewportSize;
+	int lod = 0;
+	while (lod < lodErrors.size() && 
+		lodErrors[lod] * diameterPixels <= lodPixelError)
+		++lod;
+
+	//--------------------------------------------------------------------------
+	// GLC_Mesh maps values of 0 to 100 linearly onto its levels of detail.
+	const int lodCount = lodErrors.size() + 1;
+	currentLod = lod;
+	GLC_Mesh::setCurrentLod((lod * 100 + lodCount - 1) / lodCount);
+}
+
+void repo::gui::RepoGLCMesh::setLodViewport(
+	double pixelCullingRatio, 
+	int viewportSize, 
+	double pixelError)
+{
+	lodPixelCullingRatio = pixelCullingRatio;
+	lodViewportSize = viewportSize;
+	lodPixelError = pixelError;
+}
+
+void repo::gui::RepoGLCMesh::setCompactAttributes(
+	const QVector<GLfloat> &positions,
+	const QVector<GLfloat> &normals,
+	const QVector<GLfloat> &texels)
+{
+	compactVerticesCount = positions.size() / 3;
+	compactBoundingBox = GLC_BoundingBox();
+	for (int i = 0; i < compactVerticesCount; ++i)
+		compactBoundingBox.combine(GLC_Point3d(
+			positions[3 * i], positions[3 * i + 1], positions[3 * i + 2]));
+
+	//--------------------------------------------------------------------------
+	// Positions are quantised relative to the centre of the bounding box,
+	// the shader reads them normalised to [-1, 1].
+	const GLC_Point3d lower = compactBoundingBox.lowerCorner();
+	const GLC_Point3d upper = compactBoundingBox.upperCorner();
+	for (int k = 0; k < 3; ++k)
+	{
+		compactOffset[k] = compactVerticesCount ? (lower[k] + upper[k]) * 0.5 : 0.0;
+		compactScale[k] = compactVerticesCount ? (upper[k] - lower[k]) * 0.5 : 0.0;
+	}
+
+	const bool hasNormals = normals.size() == compactVerticesCount * 3;
+	const bool hasTexels = texels.size() == compactVerticesCount * 2;
+	compactVertices.resize(compactVerticesCount * sizeof(RepoCompactVertex));
+	RepoCompactVertex *vertices = (RepoCompactVertex *) compactVertices.data();
+	for (int i = 0; i < compactVerticesCount; ++i)
+	{
+		RepoCompactVertex &vertex = vertices[i];
+		for (int k = 0; k < 3; ++k)
+			vertex.position[k] = compactScale[k] > 0.0f 
+				? toSnorm16((positions[3 * i + k] - compactOffset[k]) / compactScale[k])
+				: 0;
+		vertex.position[3] = 0;
+		if (hasNormals)
+			toOctahedron(normals.constData() + 3 * i, vertex.normal);
+		else
+			vertex.normal[0] = vertex.normal[1] = 0;
+		vertex.texel[0] = hasTexels ? toHalf(texels[2 * i]) : 0;
+		vertex.texel[1] = hasTexels ? toHalf(texels[2 * i + 1]) : 0;
+	}
+	isCompact = true;
+}
+
+QVector<GLfloat> repo::gui::RepoGLCMesh::getPositions()
+{
+	if (!isCompact)
+		return positionVector();
+
+	QVector<GLfloat> positions;
+	QByteArray data = compactVertices;
+	if (data.isEmpty() && vertexBuffer.isCreated() && vertexBuffer.bind())
+	{
+		data.resize(compactVerticesCount * sizeof(RepoCompactVertex));
+		if (!vertexBuffer.read(0, data.data(), data.size()))
+			data.clear();
+		vertexBuffer.release();
+	}
+	if (data.size() < (int) (compactVerticesCount * sizeof(RepoCompactVertex)))
+		return positions;
+
+	positions.reserve(compactVerticesCount * 3);
+	const RepoCompactVertex *vertices = 
+		(const RepoCompactVertex *) data.constData();
+	for (int i = 0; i < compactVerticesCount; ++i)
+		for (int k = 0; k < 3; ++k)
+			positions << compactOffset[k] 
+				+ compactScale[k] * vertices[i].position[k] / 32767.0f;
+	return positions;
+}
+
+const GLC_BoundingBox& repo::gui::RepoGLCMesh::boundingBox()
+{
+	return isCompact ? compactBoundingBox : GLC_Mesh::boundingBox();
+}
+
+bool repo::gui::RepoGLCMesh::isEmpty() const
+{
+	return isCompact ? 0 == compactVerticesCount : GLC_Mesh::isEmpty();
+}
+
+void repo::gui::RepoGLCMesh::glDraw(const GLC_RenderProperties &renderProperties)
+{
+	QGLShaderProgram *program = isCompact ? getCompactProgram() : NULL;
+	if (!program)
+	{
+		GLC_Mesh::glDraw(renderProperties);
+		return;
+	}
+
+	const glc::RenderFlag renderingFlag = renderProperties.renderingFlag();
+	if (glc::WireRenderFlag == renderingFlag)
+	{
+		if (!m_WireData.isEmpty())
+		{
+			glDisable(GL_LIGHTING);
+			glColor4f(m_WireColor.redF(), m_WireColor.greenF(), 
+				m_WireColor.blueF(), m_WireColor.alphaF());
+			m_WireData.glDraw(renderProperties, GL_LINE_STRIP);
+			glEnable(GL_LIGHTING);
+		}
+		return;
+	}
+
+	if (!vertexBuffer.isCreated())
+		createCompactBuffers();
+	if (!vertexBuffer.bind())
+		return;
+	if (!indexBuffer.bind())
+	{
+		vertexBuffer.release();
+		return;
+	}
+
+	//--------------------------------------------------------------------------
+	// GLC_Lib may have its own shader bound, restored afterwards.
+	GLint previousProgram = 0;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+	program->bind();
+	const bool isSelectionMode = GLC_State::isInSelectionMode();
+	program->setUniformValue("positionOffset", 
+		compactOffset[0], compactOffset[1], compactOffset[2]);
+	program->setUniformValue("positionScale", 
+		compactScale[0], compactScale[1], compactScale[2]);
+	program->setUniformValue("isSelectionMode", isSelectionMode);
+	program->setUniformValue("textureSampler", 0);
+	program->setUniformValue("hasTexture", false);
+	program->enableAttributeArray("position");
+	program->enableAttributeArray("octNormal");
+	program->enableAttributeArray("texel");
+	program->setAttributeBuffer("position", GL_SHORT, 0, 3, sizeof(RepoCompactVertex));
+	program->setAttributeBuffer("octNormal", GL_SHORT, 8, 2, sizeof(RepoCompactVertex));
+	program->setAttributeBuffer("texel", GL_HALF_FLOAT, 12, 2, sizeof(RepoCompactVertex));
+
+	for (int i = 0; i < compactGroups.size(); ++i)
+	{
+		const CompactGroup &group = compactGroups[i];
+		if (group.lod != currentLod)
+			continue;
+		GLC_Material *material = this->material(group.materialId);
+		if (!material)
+			continue;
+		if (!isSelectionMode)
+		{
+			if (renderProperties.isSelected())
+				GLC_SelectionMaterial::glExecute();
+			else if (material->isTransparent() != 
+				(glc::TransparentRenderFlag == renderingFlag))
+				continue;
+			else
+				material->glExecute();
+			program->setUniformValue("hasTexture", 
+				!renderProperties.isSelected() && material->hasTexture());
+		}
+		glDrawElements(GL_TRIANGLES, group.count, GL_UNSIGNED_INT, 
+			(const void *) (group.offset * sizeof(GLuint)));
+	}
+
+	program->disableAttributeArray("position");
+	program->disableAttributeArray("octNormal");
+	program->disableAttributeArray("texel");
+	indexBuffer.release();
+	vertexBuffer.release();
+	program->release();
+	if (previousProgram)
+		QOpenGLContext::currentContext()->functions()->glUseProgram(previousProgram);
+}
+
+void repo::gui::RepoGLCMesh::createCompactBuffers()
+{
+	//--------------------------------------------------------------------------
+	// Triangles of all levels of detail and materials in a single buffer.
+	QVector<GLuint> indices;
+	compactGroups.clear();
+	const QList<GLC_uint> ids = materialIds();
+	for (int lod = 0; lod <= lodErrors.size(); ++lod)
+		for (int i = 0; i < ids.size(); ++i)
+		{
+			if (!containsTriangles(lod, ids[i]))
+				continue;
+			const QVector<GLuint> triangles = 
+				getEquivalentTrianglesStripsFansIndex(lod, ids[i]);
+			CompactGroup group = { lod, ids[i], indices.size(), triangles.size() };
+			indices += triangles;
+			compactGroups << group;
+		}
+
+	vertexBuffer.create();
+	vertexBuffer.setUsagePattern(QGLBuffer::StaticDraw);
+	vertexBuffer.bind();
+	vertexBuffer.allocate(compactVertices.constData(), compactVertices.size());
+	vertexBuffer.release();
+
+	indexBuffer.create();
+	indexBuffer.setUsagePattern(QGLBuffer::StaticDraw);
+	indexBuffer.bind();
+	indexBuffer.allocate(indices.constData(), indices.size() * sizeof(GLuint));
+	indexBuffer.release();
+
+	// The client copy is no longer needed, just like GLC_Lib drops its own.
+	compactVertices.clear();
+}
+
+QGLShaderProgram *repo::gui::RepoGLCMesh::getCompactProgram()
+{
+	// GL widgets do not share their contexts, hence one program per context
+	// released together with it. NULL is kept for failed links.
+	static QHash<QOpenGLContext*, QGLShaderProgram*> programs;
+	QOpenGLContext *context = QOpenGLContext::currentContext();
+	if (!context)
+		return NULL;
+	if (!programs.contains(context))
+	{
+		QGLShaderProgram *program = new QGLShaderProgram();
+		const bool isLinked = 
+			program->addShaderFromSourceCode(QGLShader::Vertex, REPO_COMPACT_VERTEX_SHADER) &&
+			program->addShaderFromSourceCode(QGLShader::Fragment, REPO_COMPACT_FRAGMENT_SHADER) &&
+			program->link();
+		if (!isLinked)
+		{
+			std::cerr << "Compact vertex attributes shader failed: " 
+				<< program->log().toStdString() << std::endl;
+			delete program;
+			program = NULL;
+		}
+		programs.insert(context, program);
+
+		// The context is current while about to be destroyed.
+		QObject::connect(context, &QOpenGLContext::aboutToBeDestroyed, 
+			[context]() { delete programs.take(context); });
+	}
+	return programs.value(context);
+}
@@ -0,0 +1,239 @@
+/**
+ *  Copyright (C) 2014 3D Repo Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef REPO_GLCMESH_H
+#define REPO_GLCMESH_H
+
+//------------------------------------------------------------------------------
+#include <QByteArray>
+#include <QGLBuffer>
+#include <QGLShaderProgram>
+#include <QList>
+#include <QVector>
+//------------------------------------------------------------------------------
+#include "geometry/glc_mesh.h"
+
+namespace repo {
+namespace gui {
+
+/*!
+ * GLC mesh that builds its polygon wireframe lazily. Since GLC_Lib renders
+ * only triangles, polygon outlines have to be stored as a separate wire.
+ * Instead of adding a vertex group per face at import time, the mesh keeps
+ * the compact outline indices of its original polygons (none at all for
+ * triangle-only meshes) and turns them into a deduplicated edge list only
+ * once wire rendering is requested.
+ *
+ * Optionally the mesh stores its vertex attributes in a compact quantised
+ * form instead of GLC_Lib's floats and renders them itself.
+ */
+class RepoGLCMesh : public GLC_Mesh
+{
+
+public :
+
+	//! Default constructor.
+	RepoGLCMesh();
+
+	//! Copy constructor.
+	RepoGLCMesh(const RepoGLCMesh &other);
+
+	virtual ~RepoGLCMesh();
+
+	//! Returns a clone
+	virtual GLC_Geometry* clone() const;
+
+	/*!
+	 * Sets the outlines of the original polygon faces as a flat list of
+	 * vertex indices and the number of indices of each face. Only needed if
+	 * the triangles were obtained by triangulating polygons, otherwise the
+	 * outlines are derived from the triangles themselves. Faces of two
+	 * indices are lines, drawn as a single open edge.
+	 */
+	void setPolygonOutlines(
+		const QVector<GLuint> &outlineIndices,
+		const QVector<GLuint> &outlineSizes);
+
+	//! Returns true if the polygon wireframe has already been created.
+	bool hasPolygonWireframe() const { return isPolygonWireframeCreated; }
+
+	/*!
+	 * Creates the polygon wireframe from a single indexed edge list with
+	 * shared edges removed. Edges are chained into as few vertex groups as
+	 * possible. Needs a current OpenGL context if the vertex data has
+	 * already been moved into VBOs.
+	 */
+	void createPolygonWireframe();
+
+	//! Returns unique undirected edges as pairs of vertex indices.
+	QVector<GLuint> getPolygonEdges() const;
+
+	/*!
+	 * Appends a coarser level of detail made of the given triangles, which
+	 * index the vertices of the mesh. The error is the largest geometric
+	 * deviation from the full detail relative to the mesh diameter.
+	 */
+	void addLod(
+		GLC_Material *material,
+		const QList<GLuint> &triangles,
+		double relativeError);
+
+	//! Returns the relative errors of the coarser levels of detail.
+	QVector<double> getLodErrors() const { return lodErrors; }
+
+	/*!
+	 * Selects the coarsest level of detail whose error projected on screen
+	 * stays below the pixel error set by setLodViewport(). GLC_Lib passes
+	 * the complement of the screen coverage of the mesh in percent.
+	 */
+	virtual void setCurrentLod(const int value);
+
+	/*!
+	 * Sets the viewport used for selecting the level of detail: the pixel 
+	 * culling ratio of GLC_Viewport the coverage is computed against, the
+	 * viewport size in pixels and the largest acceptable error in pixels.
+	 * Meshes are rendered from the GUI thread only, hence shared by all.
+	 */
+	static void setLodViewport(
+		double pixelCullingRatio, 
+		int viewportSize, 
+		double pixelError = 1.0);
+
+	//--------------------------------------------------------------------------
+	//
+	// Compact attributes
+	//
+	//--------------------------------------------------------------------------
+
+	/*!
+	 * Stores the vertex attributes quantised in 16 bytes per vertex instead
+	 * of up to 32 bytes of floats: positions as 16 bit integers within the
+	 * bounding box, normals oct encoded into two 16 bit integers and texture
+	 * coordinates as half floats. Positions are precise to 1/65534 of the
+	 * bounding box size. Call instead of addVertice(), addNormals() and 
+	 * addTexels() and before finish(), normals and texels may be empty.
+	 *
+	 * Such a mesh is drawn by glDraw() from its own buffers with a shader
+	 * that decodes the attributes, hence it needs GLSL. Per vertex colours
+	 * are not supported.
+	 */
+	void setCompactAttributes(
+		const QVector<GLfloat> &positions,
+		const QVector<GLfloat> &normals,
+		const QVector<GLfloat> &texels);
+
+	//! Returns true if the vertex attributes are stored compact.
+	bool hasCompactAttributes() const { return isCompact; }
+
+	//! Returns the size of the compact vertex attributes in bytes.
+	qint64 getCompactBytes() const { return (qint64) compactVerticesCount * 16; }
+
+	//! Returns the vertex positions, decoded if stored compact.
+	/*!
+	 * Needs a current OpenGL context once the compact attributes have been
+	 * uploaded.
+	 */
+	QVector<GLfloat> getPositions();
+
+	//! Returns the bounding box, of the compact positions if any.
+	virtual const GLC_BoundingBox& boundingBox();
+
+	//! Returns true if the mesh has no vertices.
+	virtual bool isEmpty() const;
+
+protected :
+
+	//! Draws the compact attributes, otherwise passes on to GLC_Mesh.
+	virtual void glDraw(const GLC_RenderProperties &);
+
+private :
+
+	//! Uploads the compact attributes and the indices of all levels of detail.
+	void createCompactBuffers();
+
+	//! Returns the shader decoding compact attributes in the current context,
+	//! NULL if unavailable.
+	static QGLShaderProgram *getCompactProgram();
+
+private :
+
+	//! Flat list of vertex indices of the original polygon faces.
+	QVector<GLuint> outlineIndices;
+
+	//! Number of indices of each original polygon face.
+	QVector<GLuint> outlineSizes;
+
+	//! True once the polygon wireframe has been added to the wire data.
+	bool isPolygonWireframeCreated;
+
+	//! Relative errors of the coarser levels of detail, LOD 0 excluded.
+	QVector<double> lodErrors;
+
+	//! Pixel culling ratio of the viewport being rendered.
+	static double lodPixelCullingRatio;
+
+	//! Size in pixels of the viewport being rendered.
+	static int lodViewportSize;
+
+	//! Largest acceptable error in pixels.
+	static double lodPixelError;
+
+	//! Level of detail selected by the last setCurrentLod().
+	int currentLod;
+
+	//! Triangles of a single material within a level of detail.
+	struct CompactGroup
+	{
+		int lod;
+		GLC_uint materialId;
+		int offset;
+		int count;
+	};
+
+	//! True if the attributes are stored compact.
+	bool isCompact;
+
+	//! Number of compact vertices.
+	int compactVerticesCount;
+
+	//! Interleaved compact attributes until uploaded into vertexBuffer.
+	QByteArray compactVertices;
+
+	//! Centre of the bounding box the positions are quantised in.
+	GLfloat compactOffset[3];
+
+	//! Half size of the bounding box the positions are quantised in.
+	GLfloat compactScale[3];
+
+	//! Bounding box of the compact positions.
+	GLC_BoundingBox compactBoundingBox;
+
+	//! Ranges of indexBuffer per level of detail and material.
+	QVector<CompactGroup> compactGroups;
+
+	//! Compact attributes on the GPU, shared by clones.
+	QGLBuffer vertexBuffer;
+
+	//! Indices of all levels of detail on the GPU, shared by clones.
+	QGLBuffer indexBuffer;
+
+}; // end class
+
+} // end namespace gui
+} // end namespace repo
+
+#endif // end REPO_GLCMESH_H
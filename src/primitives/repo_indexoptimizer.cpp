@@ -0,0 +1,297 @@
+/**
+ *  Copyright (C) 2014 3D Repo Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "repo_indexoptimizer.h"
+//------------------------------------------------------------------------------
+#include <algorithm>
+#include <cmath>
+//------------------------------------------------------------------------------
+#include <QMutexLocker>
+#include <QPair>
+
+repo::gui::RepoIndexOptimizer::RepoIndexOptimizer()
+	: trianglesCount(0)
+	, missesBefore(0)
+	, missesAfter(0)
+{}
+
+QList<GLuint> repo::gui::RepoIndexOptimizer::optimize(
+	const QList<GLuint> &triangles,
+	const GLfloat *positions,
+	unsigned int verticesCount)
+{
+	qint64 before = 0;
+	qint64 after = 0;
+	const QList<GLuint> result = 
+		reorder(triangles, positions, verticesCount, &before, &after);
+
+	QMutexLocker locker(&mutex);
+	trianglesCount += triangles.size() / 3;
+	missesBefore += before;
+	missesAfter += after;
+	return result;
+}
+
+QList<GLuint> repo::gui::RepoIndexOptimizer::reorder(
+	const QList<GLuint> &triangles,
+	const GLfloat *positions,
+	unsigned int verticesCount,
+	qint64 *missesBefore,
+	qint64 *missesAfter)
+{
+	const QVector<GLuint> original = triangles.toVector();
+	const qint64 before = getCacheMisses(original, verticesCount);
+
+	QVector<int> clusters;
+	QVector<GLuint> result = optimizeVertexCache(original, verticesCount, clusters);
+	result = optimizeOverdraw(result, clusters, positions);
+	const qint64 after = getCacheMisses(result, verticesCount);
+
+	const bool isImproved = after < before;
+	if (missesBefore)
+		*missesBefore = before;
+	if (missesAfter)
+		*missesAfter = isImproved ? after : before;
+	return isImproved ? result.toList() : triangles;
+}
+
+double repo::gui::RepoIndexOptimizer::getACMRBefore() const
+{
+	QMutexLocker locker(&mutex);
+	return trianglesCount ? (double) missesBefore / trianglesCount : 0.0;
+}
+
+double repo::gui::RepoIndexOptimizer::getACMRAfter() const
+{
+	QMutexLocker locker(&mutex);
+	return trianglesCount ? (double) missesAfter / trianglesCount : 0.0;
+}
+
+qint64 repo::gui::RepoIndexOptimizer::getTrianglesCount() const
+{
+	QMutexLocker locker(&mutex);
+	return trianglesCount;
+}
+
+qint64 repo::gui::RepoIndexOptimizer::getCacheMisses(
+	const QVector<GLuint> &triangles,
+	unsigned int verticesCount,
+	int cacheSize)
+{
+	// A vertex is in the cache if fewer than cacheSize misses happened since
+	// it was last loaded.
+	QVector<qint64> loaded(verticesCount, 0);
+	qint64 time = cacheSize + 1;
+	qint64 misses = 0;
+	for (int i = 0; i < triangles.size(); ++i)
+	{
+		const GLuint v = triangles[i];
+		if (time - loaded[v] > cacheSize)
+		{
+			loaded[v] = time++;
+			++misses;
+		}
+	}
+	return misses;
+}
+
+QVector<GLuint> repo::gui::RepoIndexOptimizer::optimizeVertexCache(
+	const QVector<GLuint> &triangles,
+	unsigned int verticesCount,
+	QVector<int> &clusters,
+	int cacheSize)
+{
+	const int trianglesCount = triangles.size() / 3;
+	QVector<GLuint> result;
+	result.reserve(trianglesCount * 3);
+	if (0 == trianglesCount)
+		return result;
+
+	//--------------------------------------------------------------------------
+	// Vertex to triangles adjacency, live counts are the not yet emitted ones.
+	QVector<int> offsets(verticesCount + 1, 0);
+	for (int i = 0; i < trianglesCount * 3; ++i)
+		++offsets[triangles[i] + 1];
+	for (unsigned int v = 0; v < verticesCount; ++v)
+		offsets[v + 1] += offsets[v];
+	QVector<int> adjacency(trianglesCount * 3);
+	QVector<int> live(verticesCount);
+	{
+		QVector<int> fill = offsets;
+		for (int i = 0; i < trianglesCount * 3; ++i)
+			adjacency[fill[triangles[i]]++] = i / 3;
+		for (unsigned int v = 0; v < verticesCount; ++v)
+			live[v] = offsets[v + 1] - offsets[v];
+	}
+
+	QVector<int> cacheTime(verticesCount, 0);
+	QVector<bool> isEmitted(trianglesCount, false);
+	QVector<GLuint> deadEnds;
+	QVector<GLuint> candidates;
+	int time = cacheSize + 1;
+	unsigned int cursor = 0;
+
+	//--------------------------------------------------------------------------
+	// Fan out all live triangles of the current vertex, then move on to the
+	// candidate still in the cache with the most live triangles that fit.
+	int fanning = -1;
+	while (cursor < verticesCount && 0 == live[cursor])
+		++cursor;
+	if (cursor < verticesCount)
+		fanning = cursor;
+	clusters << 0;
+	while (fanning >= 0)
+	{
+		candidates.clear();
+		for (int j = offsets[fanning]; j < offsets[fanning + 1]; ++j)
+		{
+			const int t = adjacency[j];
+			if (isEmitted[t])
+				continue;
+			for (int k = 0; k < 3; ++k)
+			{
+				const GLuint v = triangles[t * 3 + k];
+				result << v;
+				deadEnds << v;
+				candidates << v;
+				--live[v];
+				if (time - cacheTime[v] > cacheSize)
+					cacheTime[v] = time++;
+			}
+			isEmitted[t] = true;
+		}
+
+		int next = -1;
+		int bestPriority = -1;
+		for (int i = 0; i < candidates.size(); ++i)
+		{
+			const GLuint v = candidates[i];
+			if (live[v] > 0)
+			{
+				int priority = 0;
+				if (time - cacheTime[v] + 2 * live[v] <= cacheSize)
+					priority = time - cacheTime[v];
+				if (priority > bestPriority)
+				{
+					bestPriority = priority;
+					next = v;
+				}
+			}
+		}
+
+		//----------------------------------------------------------------------
+		// Dead end, restart from a recently used vertex or the next live one.
+		if (next < 0)
+		{
+			while (!deadEnds.isEmpty() && next < 0)
+			{
+				const GLuint v = deadEnds.last();
+				deadEnds.pop_back();
+				if (live[v] > 0)
+					next = v;
+			}
+			while (next < 0 && cursor < verticesCount)
+			{
+				if (live[cursor] > 0)
+					next = cursor;
+				else
+					++cursor;
+			}
+			if (next >= 0)
+				clusters << result.size() / 3;
+		}
+		fanning = next;
+	}
+	return result;
+}
+
+QVector<GLuint> repo::gui::RepoIndexOptimizer::optimizeOverdraw(
+	const QVector<GLuint> &triangles,
+	const QVector<int> &clusters,
+	const GLfloat *positions)
+{
+	const int trianglesCount = triangles.size() / 3;
+	if (clusters.size() < 2)
+		return triangles;
+
+	//--------------------------------------------------------------------------
+	// Area weighted centroid and normal of each cluster.
+	QVector<double> centroids(clusters.size() * 3, 0.0);
+	QVector<double> normals(clusters.size() * 3, 0.0);
+	QVector<double> areas(clusters.size(), 0.0);
+	double meshCentroid[3] = { 0.0, 0.0, 0.0 };
+	double meshArea = 0.0;
+	for (int c = 0; c < clusters.size(); ++c)
+	{
+		const int end = c + 1 < clusters.size() ? clusters[c + 1] : trianglesCount;
+		for (int t = clusters[c]; t < end; ++t)
+		{
+			const GLfloat *a = positions + 3 * triangles[t * 3];
+			const GLfloat *b = positions + 3 * triangles[t * 3 + 1];
+			const GLfloat *d = positions + 3 * triangles[t * 3 + 2];
+			const double u[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+			const double v[3] = { d[0] - a[0], d[1] - a[1], d[2] - a[2] };
+			const double n[3] = {
+				u[1] * v[2] - u[2] * v[1],
+				u[2] * v[0] - u[0] * v[2],
+				u[0] * v[1] - u[1] * v[0] };
+			const double area = 0.5 * std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+			for (int k = 0; k < 3; ++k)
+			{
+				centroids[c * 3 + k] += area * (a[k] + b[k] + d[k]) / 3.0;
+				normals[c * 3 + k] += n[k];
+			}
+			areas[c] += area;
+		}
+		for (int k = 0; k < 3; ++k)
+			meshCentroid[k] += centroids[c * 3 + k];
+		meshArea += areas[c];
+	}
+	if (meshArea <= 0.0)
+		return triangles;
+	for (int k = 0; k < 3; ++k)
+		meshCentroid[k] /= meshArea;
+
+	//--------------------------------------------------------------------------
+	// The more a cluster faces away from the centre, the more likely it
+	// occludes the others, so it goes first.
+	QVector<QPair<double, int> > order(clusters.size());
+	for (int c = 0; c < clusters.size(); ++c)
+	{
+		double dot = 0.0;
+		if (areas[c] > 0.0)
+		{
+			const double *n = normals.constData() + c * 3;
+			const double length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+			for (int k = 0; k < 3 && length > 0.0; ++k)
+				dot += (centroids[c * 3 + k] / areas[c] - meshCentroid[k]) * n[k] / length;
+		}
+		order[c] = qMakePair(-dot, c);
+	}
+	std::stable_sort(order.begin(), order.end());
+
+	QVector<GLuint> result;
+	result.reserve(triangles.size());
+	for (int i = 0; i < order.size(); ++i)
+	{
+		const int c = order[i].second;
+		const int end = c + 1 < clusters.size() ? clusters[c + 1] : trianglesCount;
+		for (int j = clusters[c] * 3; j < end * 3; ++j)
+			result << triangles[j];
+	}
+	return result;
+}
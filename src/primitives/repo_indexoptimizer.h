@@ -0,0 +1,131 @@
+/**
+ *  Copyright (C) 2014 3D Repo Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef REPO_INDEX_OPTIMIZER_H
+#define REPO_INDEX_OPTIMIZER_H
+
+//------------------------------------------------------------------------------
+#include <QList>
+#include <QMutex>
+#include <QVector>
+#include <qopengl.h>
+
+namespace repo {
+namespace gui {
+
+/*!
+ * Reorders triangle index lists for the GPU. Triangles are first sorted for
+ * the post-transform vertex cache using Tipsify (Sander et al. 2007), which
+ * also splits them into clusters wherever it runs into a dead end. Clusters
+ * are then sorted so that those facing outwards from the centre of the mesh
+ * are drawn first, which reduces overdraw without losing cache locality.
+ *
+ * A single optimizer can be shared by meshes converted on several threads,
+ * it accumulates the average cache miss ratio (ACMR, transformed vertices
+ * per triangle) of all lists before and after reordering.
+ */
+class RepoIndexOptimizer
+{
+
+public :
+
+	//! Simulated FIFO vertex cache size.
+	static const int REPO_VERTEX_CACHE_SIZE = 16;
+
+public :
+
+	//! Creates an optimizer with empty statistics.
+	RepoIndexOptimizer();
+
+	/*!
+	 * Returns the given triangles reordered for the vertex cache and for
+	 * overdraw. Positions are x, y, z triplets of all the vertices. The
+	 * original order is kept if it already has fewer cache misses.
+	 */
+	QList<GLuint> optimize(
+		const QList<GLuint> &triangles,
+		const GLfloat *positions,
+		unsigned int verticesCount);
+
+	//! Returns the ACMR of all triangles before reordering.
+	double getACMRBefore() const;
+
+	//! Returns the ACMR of all triangles after reordering.
+	double getACMRAfter() const;
+
+	//! Returns the number of triangles passed through the optimizer.
+	qint64 getTrianglesCount() const;
+
+	//--------------------------------------------------------------------------
+	//
+	// Static helpers
+	//
+	//--------------------------------------------------------------------------
+
+	/*!
+	 * Returns the given triangles reordered without accumulating statistics,
+	 * optionally returns the cache misses before and after.
+	 */
+	static QList<GLuint> reorder(
+		const QList<GLuint> &triangles,
+		const GLfloat *positions,
+		unsigned int verticesCount,
+		qint64 *missesBefore = NULL,
+		qint64 *missesAfter = NULL);
+
+	//! Returns the number of vertex cache misses of a FIFO cache.
+	static qint64 getCacheMisses(
+		const QVector<GLuint> &triangles,
+		unsigned int verticesCount,
+		int cacheSize = REPO_VERTEX_CACHE_SIZE);
+
+	/*!
+	 * Returns the triangles in Tipsify order. Offsets of the triangles
+	 * (not indices) starting a new cluster are appended to clusters.
+	 */
+	static QVector<GLuint> optimizeVertexCache(
+		const QVector<GLuint> &triangles,
+		unsigned int verticesCount,
+		QVector<int> &clusters,
+		int cacheSize = REPO_VERTEX_CACHE_SIZE);
+
+	//! Returns the clusters sorted from the most outward facing one.
+	static QVector<GLuint> optimizeOverdraw(
+		const QVector<GLuint> &triangles,
+		const QVector<int> &clusters,
+		const GLfloat *positions);
+
+private :
+
+	//! Guards the statistics.
+	mutable QMutex mutex;
+
+	//! Number of triangles passed through the optimizer.
+	qint64 trianglesCount;
+
+	//! Cache misses of the original orders.
+	qint64 missesBefore;
+
+	//! Cache misses of the resulting orders.
+	qint64 missesAfter;
+
+}; // end class
+
+} // end namespace gui
+} // end namespace repo
+
+#endif // end REPO_INDEX_OPTIMIZER_H
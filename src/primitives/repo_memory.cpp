@@ -0,0 +1,100 @@
+/**
+ *  Copyright (C) 2014 3D Repo Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "repo_memory.h"
+
+#if defined(Q_OS_WIN)
+	#include <windows.h>
+	#include <psapi.h>
+#elif defined(Q_OS_MAC)
+	#include <sys/resource.h>
+	#include <sys/sysctl.h>
+	#include <mach/mach.h>
+#else
+	#include <sys/resource.h>
+	#include <unistd.h>
+	#include <cstdio>
+#endif
+
+qint64 repo::gui::RepoMemory::getPeakResidentBytes()
+{
+	qint64 bytes = 0;
+#if defined(Q_OS_WIN)
+	PROCESS_MEMORY_COUNTERS counters;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		bytes = (qint64) counters.PeakWorkingSetSize;
+#else
+	struct rusage usage;
+	if (0 == getrusage(RUSAGE_SELF, &usage))
+	{
+	#if defined(Q_OS_MAC)
+		bytes = (qint64) usage.ru_maxrss; // bytes on OS X
+	#else
+		bytes = (qint64) usage.ru_maxrss * 1024; // kilobytes on Linux
+	#endif
+	}
+#endif
+	return bytes;
+}
+
+qint64 repo::gui::RepoMemory::getCurrentResidentBytes()
+{
+	qint64 bytes = 0;
+#if defined(Q_OS_WIN)
+	PROCESS_MEMORY_COUNTERS counters;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		bytes = (qint64) counters.WorkingSetSize;
+#elif defined(Q_OS_MAC)
+	struct mach_task_basic_info info;
+	mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+	if (KERN_SUCCESS == task_info(mach_task_self(), MACH_TASK_BASIC_INFO,
+		(task_info_t) &info, &count))
+		bytes = (qint64) info.resident_size;
+#else
+	FILE *file = fopen("/proc/self/statm", "r");
+	if (file)
+	{
+		long pages = 0;
+		if (1 == fscanf(file, "%*s %ld", &pages))
+			bytes = (qint64) pages * sysconf(_SC_PAGESIZE);
+		fclose(file);
+	}
+#endif
+	return bytes;
+}
+
+qint64 repo::gui::RepoMemory::getPhysicalBytes()
+{
+	qint64 bytes = 0;
+#if defined(Q_OS_WIN)
+	MEMORYSTATUSEX status;
+	status.dwLength = sizeof(status);
+	if (GlobalMemoryStatusEx(&status))
+		bytes = (qint64) status.ullTotalPhys;
+#elif defined(Q_OS_MAC)
+	int mib[2] = { CTL_HW, HW_MEMSIZE };
+	uint64_t memory = 0;
+	size_t length = sizeof(memory);
+	if (0 == sysctl(mib, 2, &memory, &length, NULL, 0))
+		bytes = (qint64) memory;
+#else
+	const long pages = sysconf(_SC_PHYS_PAGES);
+	if (pages > 0)
+		bytes = (qint64) pages * sysconf(_SC_PAGESIZE);
+#endif
+	return bytes;
+}
@@ -0,0 +1,55 @@
+/**
+ *  Copyright (C) 2014 3D Repo Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef REPO_MEMORY_H
+#define REPO_MEMORY_H
+
+//------------------------------------------------------------------------------
+#include <QtGlobal>
+//------------------------------------------------------------------------------
+
+namespace repo {
+namespace gui {
+
+/*!
+ * Platform specific queries of the memory footprint of this process, used
+ * to report memory high-water marks in the log.
+ */
+class RepoMemory
+{
+
+public :
+
+	//! Returns the peak resident set size of this process in bytes, 0 if unknown.
+	static qint64 getPeakResidentBytes();
+
+	//! Returns the current resident set size of this process in bytes, 0 if unknown.
+	static qint64 getCurrentResidentBytes();
+
+	//! Returns the physical memory of the machine in bytes, 0 if unknown.
+	static qint64 getPhysicalBytes();
+
+	//! Returns the given number of bytes in megabytes.
+	static double toMegabytes(qint64 bytes)
+	{ return bytes / (1024.0 * 1024.0); }
+
+}; // end class
+
+} // end namespace gui
+} // end namespace repo
+
+#endif // end REPO_MEMORY_H
@@ -0,0 +1,132 @@
+/**
+ *  Copyright (C) 2014 3D Repo Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "repo_meshindexcache.h"
+//------------------------------------------------------------------------------
+#include <cstring>
+//------------------------------------------------------------------------------
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QMutexLocker>
+//------------------------------------------------------------------------------
+
+//! Header of every written cache, bumped whenever the format changes.
+static const char REPO_MESH_INDEX_CACHE_MAGIC[] = "3DRMI001";
+static const int REPO_MESH_INDEX_CACHE_MAGIC_SIZE = 8;
+
+repo::gui::RepoMeshIndexCache::RepoMeshIndexCache(
+	const QVector<double> &lodErrors,
+	bool indexOptimization)
+	: lodErrors(lodErrors)
+	, indexOptimization(indexOptimization)
+	, modified(false)
+{}
+
+QByteArray repo::gui::RepoMeshIndexCache::getKey(
+	const GLfloat *positions,
+	int positionsCount,
+	const QList<GLuint> &triangles)
+{
+	QCryptographicHash hash(QCryptographicHash::Sha1);
+	hash.addData((const char *) positions, positionsCount * sizeof(GLfloat));
+
+	// QList does not store its items contiguously, hence copied in blocks.
+	GLuint block[1024];
+	for (int i = 0; i < triangles.size(); i += 1024)
+	{
+		const int count = qMin(1024, triangles.size() - i);
+		for (int j = 0; j < count; ++j)
+			block[j] = triangles[i + j];
+		hash.addData((const char *) block, count * sizeof(GLuint));
+	}
+	return hash.result();
+}
+
+bool repo::gui::RepoMeshIndexCache::find(const QByteArray &key, Entry &entry) const
+{
+	QMutexLocker locker(&mutex);
+	QHash<QByteArray, Entry>::const_iterator it = entries.find(key);
+	if (it == entries.end())
+		return false;
+	entry = it.value();
+	return true;
+}
+
+void repo::gui::RepoMeshIndexCache::insert(const QByteArray &key, const Entry &entry)
+{
+	QMutexLocker locker(&mutex);
+	entries.insert(key, entry);
+	modified = true;
+}
+
+bool repo::gui::RepoMeshIndexCache::isModified() const
+{
+	QMutexLocker locker(&mutex);
+	return modified;
+}
+
+bool repo::gui::RepoMeshIndexCache::read(QIODevice *device)
+{
+	char magic[REPO_MESH_INDEX_CACHE_MAGIC_SIZE];
+	if (REPO_MESH_INDEX_CACHE_MAGIC_SIZE != device->read(magic, sizeof(magic)) ||
+		0 != memcmp(magic, REPO_MESH_INDEX_CACHE_MAGIC, sizeof(magic)))
+		return false;
+
+	QDataStream stream(device);
+	stream.setVersion(QDataStream::Qt_5_3);
+	QVector<double> storedLodErrors;
+	bool storedIndexOptimization = false;
+	stream >> storedLodErrors >> storedIndexOptimization;
+	if (QDataStream::Ok != stream.status() ||
+		storedLodErrors != lodErrors ||
+		storedIndexOptimization != indexOptimization)
+		return false;
+
+	QHash<QByteArray, Entry> storedEntries;
+	qint32 count = 0;
+	stream >> count;
+	for (qint32 i = 0; i < count && QDataStream::Ok == stream.status(); ++i)
+	{
+		QByteArray key;
+		Entry entry;
+		stream >> key >> entry.triangles >> entry.lods >> entry.lodErrors;
+		storedEntries.insert(key, entry);
+	}
+	if (QDataStream::Ok != stream.status())
+		return false;
+
+	QMutexLocker locker(&mutex);
+	entries = storedEntries;
+	modified = false;
+	return true;
+}
+
+bool repo::gui::RepoMeshIndexCache::write(QIODevice *device) const
+{
+	QMutexLocker locker(&mutex);
+	device->write(REPO_MESH_INDEX_CACHE_MAGIC, REPO_MESH_INDEX_CACHE_MAGIC_SIZE);
+	QDataStream stream(device);
+	stream.setVersion(QDataStream::Qt_5_3);
+	stream << lodErrors << indexOptimization << (qint32) entries.size();
+	for (QHash<QByteArray, Entry>::const_iterator it = entries.begin();
+		it != entries.end(); ++it)
+	{
+		const Entry &entry = it.value();
+		stream << it.key() << entry.triangles << entry.lods << entry.lodErrors;
+	}
+	return QDataStream::Ok == stream.status();
+}
@@ -0,0 +1,115 @@
+/**
+ *  Copyright (C) 2014 3D Repo Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef REPO_MESH_INDEX_CACHE_H
+#define REPO_MESH_INDEX_CACHE_H
+
+//------------------------------------------------------------------------------
+#include <QByteArray>
+#include <QHash>
+#include <QIODevice>
+#include <QList>
+#include <QMutex>
+#include <QVector>
+//------------------------------------------------------------------------------
+#include "glc_config.h"
+//------------------------------------------------------------------------------
+
+namespace repo {
+namespace gui {
+
+/*!
+ * Triangle lists derived from the meshes of a scene, ie the triangles
+ * reordered for the vertex cache and the coarser levels of detail, keyed by
+ * the content of each mesh. Filled in while a scene is transcoded and
+ * reused the next time the same scene is transcoded with the same settings,
+ * so that neither the simplification nor the reordering are repeated.
+ * Shared by the conversion threads.
+ */
+class RepoMeshIndexCache
+{
+
+public :
+
+	//! Derived triangle lists of a single mesh.
+	struct Entry
+	{
+		//! All triangles, reordered if the index optimization is on.
+		QList<GLuint> triangles;
+
+		//! Triangles of the coarser levels of detail.
+		QList<QList<GLuint> > lods;
+
+		//! Relative geometric errors of the levels of detail.
+		QList<double> lodErrors;
+	};
+
+public :
+
+	//! Creates an empty cache valid for the given transcoder settings.
+	RepoMeshIndexCache(const QVector<double> &lodErrors, bool indexOptimization);
+
+	/*!
+	 * Returns a key identifying the mesh made of the given number of x, y, z
+	 * position floats and triangles as they come before reordering.
+	 */
+	static QByteArray getKey(
+		const GLfloat *positions,
+		int positionsCount,
+		const QList<GLuint> &triangles);
+
+	//! Copies the entry of the given key into entry, false if there is none.
+	bool find(const QByteArray &key, Entry &entry) const;
+
+	//! Adds the entry under the given key.
+	void insert(const QByteArray &key, const Entry &entry);
+
+	//! Returns true if entries were inserted since created or read.
+	bool isModified() const;
+
+	/*!
+	 * Reads the entries written by write(), false and left empty if the
+	 * device holds entries of different settings or is corrupted.
+	 */
+	bool read(QIODevice *device);
+
+	//! Writes all entries along with the settings they are valid for.
+	bool write(QIODevice *device) const;
+
+private :
+
+	//! Level of detail errors the entries were created with.
+	QVector<double> lodErrors;
+
+	//! Whether the triangles of the entries are reordered.
+	bool indexOptimization;
+
+	//! Entries keyed by mesh content.
+	QHash<QByteArray, Entry> entries;
+
+	//! True if entries were inserted since created or read.
+	bool modified;
+
+	//! Guards all of the above.
+	mutable QMutex mutex;
+
+}; // end class
+
+} // end namespace gui
+} // end namespace repo
+
+#endif // end REPO_MESH_INDEX_CACHE_H
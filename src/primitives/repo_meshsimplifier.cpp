@@ -0,0 +1,432 @@
+/**
+ *  Copyright (C) 2014 3D Repo Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "repo_meshsimplifier.h"
+//------------------------------------------------------------------------------
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+//------------------------------------------------------------------------------
+
+//! Returns b - a of two position triplets.
+static inline void subtract(const GLfloat *a, const GLfloat *b, double *result)
+{
+	result[0] = (double) b[0] - a[0];
+	result[1] = (double) b[1] - a[1];
+	result[2] = (double) b[2] - a[2];
+}
+
+//! Returns the (not normalised) normal of a triangle.
+static inline void normal(
+	const GLfloat *a,
+	const GLfloat *b,
+	const GLfloat *c,
+	double *result)
+{
+	double u[3], v[3];
+	subtract(a, b, u);
+	subtract(a, c, v);
+	result[0] = u[1] * v[2] - u[2] * v[1];
+	result[1] = u[2] * v[0] - u[0] * v[2];
+	result[2] = u[0] * v[1] - u[1] * v[0];
+}
+
+repo::gui::RepoMeshSimplifier::RepoMeshSimplifier(
+	const GLfloat *positions,
+	unsigned int verticesCount,
+	const QList<GLuint> &triangles)
+	: positions(positions)
+	, indices(triangles.toVector())
+	, error(0.0)
+	, diameter(0.0)
+{
+	//--------------------------------------------------------------------------
+	// Bounding box of the referenced vertices.
+	double min[3], max[3];
+	for (int j = 0; j < 3; ++j)
+	{
+		min[j] = std::numeric_limits<double>::max();
+		max[j] = -std::numeric_limits<double>::max();
+	}
+	for (int i = 0; i < indices.size(); ++i)
+	{
+		const GLfloat *p = positions + 3 * indices[i];
+		for (int j = 0; j < 3; ++j)
+		{
+			min[j] = std::min(min[j], (double) p[j]);
+			max[j] = std::max(max[j], (double) p[j]);
+		}
+	}
+	if (!indices.isEmpty())
+		diameter = std::sqrt(
+			(max[0] - min[0]) * (max[0] - min[0]) +
+			(max[1] - min[1]) * (max[1] - min[1]) +
+			(max[2] - min[2]) * (max[2] - min[2]));
+
+	weldPositions(verticesCount);
+
+	//--------------------------------------------------------------------------
+	// Area weighted plane quadrics of the triangles around each position. The
+	// summed area is kept alongside so that the error is a mean squared 
+	// distance rather than one scaled by the area.
+	Quadric zero;
+	memset(&zero, 0, sizeof(Quadric));
+	quadrics.fill(zero, verticesCount);
+	for (int t = 0; t + 2 < indices.size(); t += 3)
+	{
+		double n[3];
+		normal(
+			positions + 3 * indices[t],
+			positions + 3 * indices[t + 1],
+			positions + 3 * indices[t + 2],
+			n);
+		const double length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+		if (length <= 0.0)
+			continue;
+		const double a = n[0] / length;
+		const double b = n[1] / length;
+		const double c = n[2] / length;
+		const GLfloat *p = positions + 3 * indices[t];
+		const double d = -(a * p[0] + b * p[1] + c * p[2]);
+		const double w = length * 0.5;
+		for (int k = 0; k < 3; ++k)
+		{
+			Quadric &q = quadrics[welded[indices[t + k]]];
+			q.a2 += w * a * a; q.ab += w * a * b; q.ac += w * a * c;
+			q.ad += w * a * d; q.b2 += w * b * b; q.bc += w * b * c;
+			q.bd += w * b * d; q.c2 += w * c * c; q.cd += w * c * d;
+			q.d2 += w * d * d; q.w += w;
+		}
+	}
+
+	lockBorders();
+}
+
+QList<GLuint> repo::gui::RepoMeshSimplifier::simplify(double maxError)
+{
+	const double maxCost = maxError * maxError;
+	const int verticesCount = quadrics.size();
+	QVector<GLuint> remap(verticesCount);
+	QVector<bool> touched(verticesCount);
+	QVector<Collapse> collapses;
+
+	//--------------------------------------------------------------------------
+	// Each pass collapses the cheapest independent edges, ie no two collapses
+	// of one pass share a triangle, and then rewrites the indices. Collapses
+	// move welded positions, ie all the vertices at one position at once.
+	int collapsedCount = 1;
+	while (collapsedCount > 0 && !indices.isEmpty())
+	{
+		updateAdjacency();
+		collapses.clear();
+		for (int i = 0; i < indices.size(); ++i)
+		{
+			const GLuint a = welded[indices[i]];
+			const GLuint b = welded[indices[i - i % 3 + (i + 1) % 3]];
+			if (a >= b || (locked[a] && locked[b]))
+				continue;
+
+			Quadric q = quadrics[a];
+			q += quadrics[b];
+
+			Collapse collapse;
+			collapse.cost = std::numeric_limits<double>::max();
+			if (!locked[a])
+			{
+				collapse.from = a;
+				collapse.to = b;
+				collapse.cost = evaluate(q, positions + 3 * b);
+			}
+			if (!locked[b])
+			{
+				const double cost = evaluate(q, positions + 3 * a);
+				if (cost < collapse.cost)
+				{
+					collapse.from = b;
+					collapse.to = a;
+					collapse.cost = cost;
+				}
+			}
+			if (collapse.cost <= maxCost)
+				collapses << collapse;
+		}
+		std::sort(collapses.begin(), collapses.end());
+
+		for (int i = 0; i < verticesCount; ++i)
+		{
+			remap[i] = i;
+			touched[i] = false;
+		}
+
+		collapsedCount = 0;
+		for (int i = 0; i < collapses.size(); ++i)
+		{
+			const Collapse &collapse = collapses[i];
+			if (touched[collapse.from] || touched[collapse.to] ||
+				!isCollapseValid(collapse.from, collapse.to, remap))
+				continue;
+
+			quadrics[collapse.to] += quadrics[collapse.from];
+			error = std::max(error, std::sqrt(std::max(collapse.cost, 0.0)));
+
+			// Triangles around the moved position change, leave them for the
+			// next pass.
+			touched[collapse.to] = true;
+			for (int c = copyOffsets[collapse.from];
+				c < copyOffsets[collapse.from + 1]; ++c)
+				for (int j = adjacencyOffsets[copies[c]];
+					j < adjacencyOffsets[copies[c] + 1]; ++j)
+				{
+					const int t = adjacentTriangles[j] * 3;
+					touched[welded[indices[t]]] = true;
+					touched[welded[indices[t + 1]]] = true;
+					touched[welded[indices[t + 2]]] = true;
+				}
+			++collapsedCount;
+		}
+
+		//----------------------------------------------------------------------
+		// Rewrite indices, triangles around collapsed edges degenerate.
+		int size = 0;
+		for (int t = 0; t + 2 < indices.size(); t += 3)
+		{
+			const GLuint a = remap[indices[t]];
+			const GLuint b = remap[indices[t + 1]];
+			const GLuint c = remap[indices[t + 2]];
+			if (welded[a] != welded[b] && 
+				welded[b] != welded[c] && 
+				welded[a] != welded[c])
+			{
+				indices[size++] = a;
+				indices[size++] = b;
+				indices[size++] = c;
+			}
+		}
+		indices.resize(size);
+	}
+	return indices.toList();
+}
+
+double repo::gui::RepoMeshSimplifier::evaluate(
+	const Quadric &q,
+	const GLfloat *point)
+{
+	if (q.w <= 0.0)
+		return 0.0;
+	const double x = point[0];
+	const double y = point[1];
+	const double z = point[2];
+	return (q.a2 * x * x + 2 * q.ab * x * y + 2 * q.ac * x * z + 2 * q.ad * x
+		+ q.b2 * y * y + 2 * q.bc * y * z + 2 * q.bd * y
+		+ q.c2 * z * z + 2 * q.cd * z
+		+ q.d2) / q.w;
+}
+
+void repo::gui::RepoMeshSimplifier::weldPositions(unsigned int verticesCount)
+{
+	//--------------------------------------------------------------------------
+	// Vertices split at the same position for differing normals or texture
+	// coordinates are represented by the first of them.
+	QVector<GLuint> order(verticesCount);
+	for (unsigned int i = 0; i < verticesCount; ++i)
+		order[i] = i;
+	const GLfloat *p = positions;
+	std::sort(order.begin(), order.end(), [p](GLuint a, GLuint b) {
+		return std::lexicographical_compare(p + 3 * a, p + 3 * a + 3, p + 3 * b, p + 3 * b + 3);
+	});
+	welded.resize(verticesCount);
+	for (unsigned int i = 0; i < verticesCount;)
+	{
+		unsigned int j = i;
+		GLuint first = order[i];
+		for (; j < verticesCount && 
+			!std::lexicographical_compare(p + 3 * order[i], p + 3 * order[i] + 3, 
+				p + 3 * order[j], p + 3 * order[j] + 3); ++j)
+			first = std::min(first, order[j]);
+		for (; i < j; ++i)
+			welded[order[i]] = first;
+	}
+
+	//--------------------------------------------------------------------------
+	// Vertices of each welded position.
+	copyOffsets.fill(0, verticesCount + 1);
+	for (unsigned int i = 0; i < verticesCount; ++i)
+		++copyOffsets[welded[i] + 1];
+	for (unsigned int i = 0; i < verticesCount; ++i)
+		copyOffsets[i + 1] += copyOffsets[i];
+	copies.resize(verticesCount);
+	QVector<int> fill = copyOffsets;
+	for (unsigned int i = 0; i < verticesCount; ++i)
+		copies[fill[welded[i]]++] = i;
+}
+
+void repo::gui::RepoMeshSimplifier::lockBorders()
+{
+	locked.fill(false, welded.size());
+
+	//--------------------------------------------------------------------------
+	// Open border and non-manifold edges of the welded surface are not shared 
+	// by exactly two triangles. Attribute seams are shared by two triangles
+	// once welded and stay free to move along the seam.
+	QVector<quint64> edges;
+	edges.reserve(indices.size());
+	for (int i = 0; i < indices.size(); ++i)
+	{
+		GLuint a = welded[indices[i]];
+		GLuint b = welded[indices[i - i % 3 + (i + 1) % 3]];
+		if (a > b)
+			std::swap(a, b);
+		edges << (((quint64) a << 32) | b);
+	}
+	std::sort(edges.begin(), edges.end());
+	for (int i = 0; i < edges.size();)
+	{
+		int j = i + 1;
+		while (j < edges.size() && edges[j] == edges[i])
+			++j;
+		if (j - i != 2)
+		{
+			locked[(GLuint) (edges[i] >> 32)] = true;
+			locked[(GLuint) (edges[i] & 0xFFFFFFFF)] = true;
+		}
+		i = j;
+	}
+}
+
+bool repo::gui::RepoMeshSimplifier::isCollapseValid(
+	GLuint from, 
+	GLuint to,
+	QVector<GLuint> &remap) const
+{
+	//--------------------------------------------------------------------------
+	// Every vertex at the from position moves onto a vertex at the to position
+	// it shares an edge with, so that attributes do not leak across seams. 
+	// Vertices without such an edge would cross a seam.
+	QVector<GLuint> targets;
+	for (int c = copyOffsets[from]; c < copyOffsets[from + 1]; ++c)
+	{
+		const GLuint copy = copies[c];
+		GLuint target = copy;
+		for (int j = adjacencyOffsets[copy]; 
+			target == copy && j < adjacencyOffsets[copy + 1]; ++j)
+		{
+			const int t = adjacentTriangles[j] * 3;
+			for (int k = 0; k < 3; ++k)
+				if (welded[indices[t + k]] == to)
+					target = indices[t + k];
+		}
+		if (target == copy && adjacencyOffsets[copy] < adjacencyOffsets[copy + 1])
+			return false;
+		targets << target;
+	}
+
+	//--------------------------------------------------------------------------
+	// Link condition: the only common neighbours of both positions are the
+	// opposite positions of the triangles sharing the edge, otherwise the
+	// collapse would create non-manifold geometry.
+	QVector<GLuint> fromNeighbours;
+	QVector<GLuint> toNeighbours;
+	int sharedTriangles = 0;
+	for (int c = copyOffsets[from]; c < copyOffsets[from + 1]; ++c)
+		for (int j = adjacencyOffsets[copies[c]]; 
+			j < adjacencyOffsets[copies[c] + 1]; ++j)
+		{
+			const int t = adjacentTriangles[j] * 3;
+			bool isShared = false;
+			for (int k = 0; k < 3; ++k)
+			{
+				const GLuint position = welded[indices[t + k]];
+				isShared = isShared || position == to;
+				if (position != from)
+					fromNeighbours << position;
+			}
+			if (isShared)
+				++sharedTriangles;
+			else
+			{
+				//--------------------------------------------------------------
+				// Triangle must not flip nor degenerate once moved.
+				const GLfloat *p[3];
+				const GLfloat *q[3];
+				for (int k = 0; k < 3; ++k)
+				{
+					p[k] = positions + 3 * indices[t + k];
+					q[k] = welded[indices[t + k]] == from ? 
+						positions + 3 * to : p[k];
+				}
+				double before[3], after[3];
+				normal(p[0], p[1], p[2], before);
+				normal(q[0], q[1], q[2], after);
+				if (before[0] * after[0] + before[1] * after[1] + before[2] * after[2] <= 0.0)
+					return false;
+			}
+		}
+	for (int c = copyOffsets[to]; c < copyOffsets[to + 1]; ++c)
+		for (int j = adjacencyOffsets[copies[c]]; 
+			j < adjacencyOffsets[copies[c] + 1]; ++j)
+		{
+			const int t = adjacentTriangles[j] * 3;
+			for (int k = 0; k < 3; ++k)
+				if (welded[indices[t + k]] != to)
+					toNeighbours << welded[indices[t + k]];
+		}
+	std::sort(fromNeighbours.begin(), fromNeighbours.end());
+	std::sort(toNeighbours.begin(), toNeighbours.end());
+	fromNeighbours.erase(
+		std::unique(fromNeighbours.begin(), fromNeighbours.end()),
+		fromNeighbours.end());
+	toNeighbours.erase(
+		std::unique(toNeighbours.begin(), toNeighbours.end()),
+		toNeighbours.end());
+
+	int commonNeighbours = 0;
+	for (int i = 0, j = 0; i < fromNeighbours.size() && j < toNeighbours.size();)
+	{
+		if (fromNeighbours[i] < toNeighbours[j])
+			++i;
+		else if (toNeighbours[j] < fromNeighbours[i])
+			++j;
+		else
+		{
+			++commonNeighbours;
+			++i;
+			++j;
+		}
+	}
+	if (commonNeighbours != sharedTriangles)
+		return false;
+
+	for (int c = copyOffsets[from]; c < copyOffsets[from + 1]; ++c)
+		remap[copies[c]] = targets[c - copyOffsets[from]];
+	return true;
+}
+
+void repo::gui::RepoMeshSimplifier::updateAdjacency()
+{
+	const int verticesCount = quadrics.size();
+	adjacencyOffsets.fill(0, verticesCount + 1);
+	for (int i = 0; i < indices.size(); ++i)
+		++adjacencyOffsets[indices[i] + 1];
+	for (int i = 0; i < verticesCount; ++i)
+		adjacencyOffsets[i + 1] += adjacencyOffsets[i];
+
+	adjacentTriangles.resize(indices.size());
+	QVector<int> fill = adjacencyOffsets;
+	for (int i = 0; i < indices.size(); ++i)
+		adjacentTriangles[fill[indices[i]]++] = i / 3;
+}
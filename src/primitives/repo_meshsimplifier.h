@@ -0,0 +1,155 @@
+/**
+ *  Copyright (C) 2014 3D Repo Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef REPO_MESH_SIMPLIFIER_H
+#define REPO_MESH_SIMPLIFIER_H
+
+//------------------------------------------------------------------------------
+#include <QList>
+#include <QVector>
+#include <qopengl.h>
+
+namespace repo {
+namespace gui {
+
+/*!
+ * Quadric error metric mesh simplification (Garland & Heckbert) by half edge
+ * collapses. Every collapse moves a vertex onto one of its neighbours, hence
+ * the simplified triangles index the original vertices and can share their
+ * normals, colours and texture coordinates as a coarser level of detail.
+ *
+ * Vertices at the same position (attribute seams) are welded and move
+ * together, each onto a vertex of the target position it shares an edge
+ * with, so that the simplified mesh does not crack. Vertices on open borders
+ * are never moved.
+ * Successive calls to simplify() continue from the previous result, which
+ * makes it cheap to build a whole chain of increasingly coarse levels.
+ */
+class RepoMeshSimplifier
+{
+
+public :
+
+	/*!
+	 * Creates a simplifier of the given triangles. Positions are x, y, z
+	 * triplets and have to stay valid for the lifetime of the simplifier.
+	 */
+	RepoMeshSimplifier(
+		const GLfloat *positions,
+		unsigned int verticesCount,
+		const QList<GLuint> &triangles);
+
+	/*!
+	 * Collapses edges for as long as the geometric error stays below the
+	 * given distance and returns the remaining triangles.
+	 */
+	QList<GLuint> simplify(double maxError);
+
+	//! Returns the largest geometric error of the collapses so far, ie the
+	//! root of the area weighted mean squared distance to the original planes.
+	double getError() const { return error; }
+
+	//! Returns the number of remaining triangles.
+	int getTrianglesCount() const { return indices.size() / 3; }
+
+	//! Returns the length of the bounding box diagonal of the triangles.
+	double getDiameter() const { return diameter; }
+
+private :
+
+	//! Symmetric 4x4 matrix of a sum of squared distances to planes and the
+	//! sum of their weights.
+	struct Quadric
+	{
+		double a2, ab, ac, ad, b2, bc, bd, c2, cd, d2, w;
+		Quadric &operator+=(const Quadric &o)
+		{
+			a2 += o.a2; ab += o.ab; ac += o.ac; ad += o.ad; b2 += o.b2;
+			bc += o.bc; bd += o.bd; c2 += o.c2; cd += o.cd; d2 += o.d2;
+			w += o.w;
+			return *this;
+		}
+	};
+
+	//! Candidate collapse of vertex from onto vertex to.
+	struct Collapse
+	{
+		GLuint from, to;
+		double cost;
+		bool operator<(const Collapse &other) const { return cost < other.cost; }
+	};
+
+	//! Returns the mean squared distance error of the given point.
+	static double evaluate(const Quadric &, const GLfloat *point);
+
+	//! Maps each vertex onto the first vertex at the same position.
+	void weldPositions(unsigned int verticesCount);
+
+	//! Marks welded positions on open borders as locked.
+	void lockBorders();
+
+	/*!
+	 * Returns true if moving the welded position from onto to keeps all its
+	 * triangles facing and stays off seams, in which case the vertices at from
+	 * are remapped onto those at to.
+	 */
+	bool isCollapseValid(GLuint from, GLuint to, QVector<GLuint> &remap) const;
+
+	//! Rebuilds the vertex to triangles adjacency of the current indices.
+	void updateAdjacency();
+
+private :
+
+	//! Vertex positions as x, y, z triplets.
+	const GLfloat *positions;
+
+	//! Remaining triangles as triplets of vertex indices.
+	QVector<GLuint> indices;
+
+	//! First vertex at the same position of each vertex.
+	QVector<GLuint> welded;
+
+	//! Offsets into copies per welded position, one more than vertices.
+	QVector<int> copyOffsets;
+
+	//! Vertices at each welded position.
+	QVector<GLuint> copies;
+
+	//! Accumulated quadric of each welded position.
+	QVector<Quadric> quadrics;
+
+	//! True for welded positions which cannot be moved.
+	QVector<bool> locked;
+
+	//! Offsets into adjacentTriangles per vertex, one more than vertices.
+	QVector<int> adjacencyOffsets;
+
+	//! Indices of triangles adjacent to each vertex.
+	QVector<int> adjacentTriangles;
+
+	//! Largest error of the collapses so far.
+	double error;
+
+	//! Bounding box diagonal.
+	double diameter;
+
+}; // end class
+
+} // end namespace gui
+} // end namespace repo
+
+#endif // end REPO_MESH_SIMPLIFIER_H
@@ -0,0 +1,382 @@
+/**
+ *  Copyright (C) 2014 3D Repo Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "repo_scenecache.h"
+//------------------------------------------------------------------------------
+#include <cstring>
+#include <iostream>
+#include <set>
+#include <vector>
+//------------------------------------------------------------------------------
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMap>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QSet>
+#include <QStandardPaths>
+#include <QtEndian>
+//------------------------------------------------------------------------------
+
+const QString repo::gui::RepoSceneCache::REPO_SETTINGS_SCENE_CACHE_MAX_SIZE =
+	"RepoSceneCache/maxSize";
+
+//! Header of every cache entry file, bumped whenever the format changes.
+static const char REPO_SCENE_CACHE_MAGIC[] = "3DRSC001";
+static const int REPO_SCENE_CACHE_MAGIC_SIZE = 8;
+
+//! Guards the index shared by workers loading files at the same time.
+static QMutex indexMutex;
+
+repo::gui::RepoSceneCache::RepoSceneCache()
+	: directory(QStandardPaths::writableLocation(QStandardPaths::CacheLocation)
+		+ "/scenes")
+	, maxSize(qMax(0, getMaxSize()))
+{
+	QDir().mkpath(directory);
+}
+
+repo::gui::RepoSceneCache::RepoSceneCache(const QString &directory, int maxSize)
+	: directory(directory)
+	, maxSize(maxSize)
+{
+	QDir().mkpath(directory);
+}
+
+QString repo::gui::RepoSceneCache::getKey(
+	const QString &filePath,
+	unsigned int flags)
+{
+	QFileInfo info(filePath);
+	if (0 == maxSize || !info.isFile())
+		return QString();
+
+	//--------------------------------------------------------------------------
+	// Reuse the content hash of a file that has not changed since.
+	const QString fileGroup = "files/" + QCryptographicHash::hash(
+		info.canonicalFilePath().toUtf8(), QCryptographicHash::Sha1).toHex();
+	QString contentHash;
+	QMutexLocker locker(&indexMutex);
+	{
+		QSettings index(directory + "/index.ini", QSettings::IniFormat);
+		index.beginGroup(fileGroup);
+		if (index.value("size").toLongLong() == info.size() &&
+			index.value("modified").toDateTime() == info.lastModified())
+			contentHash = index.value("hash").toString();
+		index.endGroup();
+	}
+
+	if (contentHash.isEmpty())
+	{
+		// Hashing large files takes a while, do not block other workers.
+		locker.unlock();
+		QFile file(filePath);
+		if (!file.open(QIODevice::ReadOnly))
+			return QString();
+		QCryptographicHash hash(QCryptographicHash::Sha1);
+		hash.addData(&file);
+		contentHash = hash.result().toHex();
+		locker.relock();
+
+		QSettings index(directory + "/index.ini", QSettings::IniFormat);
+		index.beginGroup(fileGroup);
+		index.setValue("size", info.size());
+		index.setValue("modified", info.lastModified());
+		index.setValue("hash", contentHash);
+		index.endGroup();
+	}
+	return contentHash + "_" + QString::number(flags, 16);
+}
+
+repo::core::RepoGraphScene *repo::gui::RepoSceneCache::load(const QString &key)
+{
+	if (key.isEmpty())
+		return NULL;
+
+	//--------------------------------------------------------------------------
+	// Entries whose external textures, material libraries etc. changed are
+	// outdated even though the main file is not.
+	{
+		QMutexLocker locker(&indexMutex);
+		QSettings index(directory + "/index.ini", QSettings::IniFormat);
+		index.beginGroup("entries/" + key);
+		const bool isOutdated = index.contains("bytes") &&
+			index.value("signature").toString() != 
+			getSignature(index.value("dependencies").toStringList());
+		index.endGroup();
+		if (isOutdated)
+		{
+			std::cout << "Scene cache entry " << key.toStdString();
+			std::cout << " removed, its dependencies changed." << std::endl;
+			removeEntry(key);
+			index.remove("entries/" + key);
+			return NULL;
+		}
+	}
+
+	QFile file(getEntryPath(key));
+	if (!file.open(QIODevice::ReadOnly))
+		return NULL;
+
+	//--------------------------------------------------------------------------
+	// Entry is the magic header followed by consecutive BSON documents, each
+	// starting with its own little-endian 32 bit size.
+	const qint64 size = file.size();
+	const uchar *data = file.map(0, size);
+	bool isValid = data && size >= REPO_SCENE_CACHE_MAGIC_SIZE &&
+		0 == memcmp(data, REPO_SCENE_CACHE_MAGIC, REPO_SCENE_CACHE_MAGIC_SIZE);
+
+	std::vector<mongo::BSONObj> nodes;
+	qint64 offset = REPO_SCENE_CACHE_MAGIC_SIZE;
+	while (isValid && offset < size)
+	{
+		qint32 objectSize = 0;
+		if (offset + 4 <= size)
+			objectSize = qFromLittleEndian<qint32>(data + offset);
+		isValid = objectSize >= 5 && offset + objectSize <= size;
+		if (isValid)
+		{
+			nodes.push_back(mongo::BSONObj((const char *)(data + offset)).getOwned());
+			offset += objectSize;
+		}
+	}
+	if (data)
+		file.unmap((uchar *) data);
+	file.close();
+
+	if (!isValid || nodes.empty())
+	{
+		std::cerr << "Corrupted scene cache entry " << key.toStdString();
+		std::cerr << " removed." << std::endl;
+		removeEntry(key);
+		return NULL;
+	}
+
+	{
+		QMutexLocker locker(&indexMutex);
+		QSettings index(directory + "/index.ini", QSettings::IniFormat);
+		index.setValue("entries/" + key + "/used", QDateTime::currentDateTime());
+	}
+	return new core::RepoGraphScene(nodes);
+}
+
+bool repo::gui::RepoSceneCache::store(
+	const QString &key,
+	const core::RepoGraphScene *scene,
+	const QStringList &dependencies)
+{
+	if (key.isEmpty() || !scene)
+		return false;
+
+	//--------------------------------------------------------------------------
+	// Written to a temporary file first so that a half written entry never
+	// replaces a valid one.
+	QSaveFile file(getEntryPath(key));
+	if (!file.open(QIODevice::WriteOnly))
+		return false;
+	file.write(REPO_SCENE_CACHE_MAGIC, REPO_SCENE_CACHE_MAGIC_SIZE);
+	const std::set<core::RepoNodeAbstract *> nodes = scene->getNodes();
+	for (std::set<core::RepoNodeAbstract *>::const_iterator it = nodes.begin();
+		it != nodes.end(); ++it)
+	{
+		const mongo::BSONObj obj = (*it)->toBSONObj();
+		file.write(obj.objdata(), obj.objsize());
+	}
+	const qint64 bytes = file.pos();
+	if (!file.commit())
+		return false;
+
+	QMutexLocker locker(&indexMutex);
+	QSettings index(directory + "/index.ini", QSettings::IniFormat);
+	index.beginGroup("entries/" + key);
+	index.setValue("bytes", bytes);
+	index.setValue("used", QDateTime::currentDateTime());
+	index.setValue("dependencies", dependencies);
+	index.setValue("signature", getSignature(dependencies));
+	index.endGroup();
+	evict(index);
+	return true;
+}
+
+bool repo::gui::RepoSceneCache::loadIndices(
+	const QString &key,
+	RepoMeshIndexCache &indexCache)
+{
+	if (key.isEmpty())
+		return false;
+	QFile file(getIndicesPath(key));
+	return file.open(QIODevice::ReadOnly) && indexCache.read(&file);
+}
+
+bool repo::gui::RepoSceneCache::storeIndices(
+	const QString &key,
+	const RepoMeshIndexCache &indexCache)
+{
+	if (key.isEmpty() || !QFile::exists(getEntryPath(key)))
+		return false;
+
+	QSaveFile file(getIndicesPath(key));
+	if (!file.open(QIODevice::WriteOnly) || !indexCache.write(&file))
+		return false;
+	const qint64 bytes = file.pos();
+	if (!file.commit())
+		return false;
+
+	QMutexLocker locker(&indexMutex);
+	QSettings index(directory + "/index.ini", QSettings::IniFormat);
+	index.setValue("entries/" + key + "/indexBytes", bytes);
+	evict(index);
+	return true;
+}
+
+void repo::gui::RepoSceneCache::clear()
+{
+	// The index is emptied through QSettings rather than deleted so that no
+	// cached copy of it is written back later on.
+	QMutexLocker locker(&indexMutex);
+	QSettings index(directory + "/index.ini", QSettings::IniFormat);
+	index.clear();
+	index.sync();
+	QDir dir(directory);
+	const QStringList entries = dir.entryList(
+		QStringList() << "*.bson" << "*.idx", QDir::Files);
+	for (int i = 0; i < entries.size(); ++i)
+		dir.remove(entries[i]);
+}
+
+qint64 repo::gui::RepoSceneCache::getSize()
+{
+	QMutexLocker locker(&indexMutex);
+	QSettings index(directory + "/index.ini", QSettings::IniFormat);
+	qint64 bytes = 0;
+	index.beginGroup("entries");
+	const QStringList keys = index.childGroups();
+	for (int i = 0; i < keys.size(); ++i)
+		bytes += index.value(keys[i] + "/bytes").toLongLong() +
+			index.value(keys[i] + "/indexBytes").toLongLong();
+	index.endGroup();
+	return bytes;
+}
+
+int repo::gui::RepoSceneCache::getMaxSize()
+{
+	QSettings settings;
+	return settings.value(
+		REPO_SETTINGS_SCENE_CACHE_MAX_SIZE,
+		REPO_SCENE_CACHE_DEFAULT_MAX_SIZE).toInt();
+}
+
+void repo::gui::RepoSceneCache::setMaxSize(int megabytes)
+{
+	QSettings settings;
+	settings.setValue(REPO_SETTINGS_SCENE_CACHE_MAX_SIZE, megabytes);
+}
+
+QString repo::gui::RepoSceneCache::getEntryPath(const QString &key) const
+{
+	return directory + "/" + key + ".bson";
+}
+
+QString repo::gui::RepoSceneCache::getIndicesPath(const QString &key) const
+{
+	return directory + "/" + key + ".idx";
+}
+
+void repo::gui::RepoSceneCache::removeEntry(const QString &key) const
+{
+	QFile::remove(getEntryPath(key));
+	QFile::remove(getIndicesPath(key));
+}
+
+void repo::gui::RepoSceneCache::evict(QSettings &index)
+{
+	if (maxSize < 0)
+		return;
+	const qint64 maxBytes = (qint64) maxSize * 1024 * 1024;
+
+	//--------------------------------------------------------------------------
+	// Entries sorted from the least recently used one.
+	QMultiMap<QDateTime, QString> entries;
+	qint64 bytes = 0;
+	index.beginGroup("entries");
+	const QStringList keys = index.childGroups();
+	for (int i = 0; i < keys.size(); ++i)
+	{
+		if (QFile::exists(getEntryPath(keys[i])))
+		{
+			entries.insert(index.value(keys[i] + "/used").toDateTime(), keys[i]);
+			bytes += index.value(keys[i] + "/bytes").toLongLong() +
+				index.value(keys[i] + "/indexBytes").toLongLong();
+		}
+		else
+		{
+			QFile::remove(getIndicesPath(keys[i]));
+			index.remove(keys[i]);
+		}
+	}
+
+	QSet<QString> evictedHashes;
+	QMultiMap<QDateTime, QString>::const_iterator it = entries.constBegin();
+	for (; bytes > maxBytes && it != entries.constEnd(); ++it)
+	{
+		bytes -= index.value(it.value() + "/bytes").toLongLong() +
+			index.value(it.value() + "/indexBytes").toLongLong();
+		removeEntry(it.value());
+		index.remove(it.value());
+		evictedHashes.insert(getContentHash(it.value()));
+	}
+
+	//--------------------------------------------------------------------------
+	// Files whose content is no longer cached under any flags are forgotten.
+	const QStringList remainingKeys = index.childGroups();
+	for (int i = 0; i < remainingKeys.size(); ++i)
+		evictedHashes.remove(getContentHash(remainingKeys[i]));
+	index.endGroup();
+	if (!evictedHashes.isEmpty())
+	{
+		index.beginGroup("files");
+		const QStringList files = index.childGroups();
+		for (int i = 0; i < files.size(); ++i)
+			if (evictedHashes.contains(index.value(files[i] + "/hash").toString()))
+				index.remove(files[i]);
+		index.endGroup();
+	}
+}
+
+QString repo::gui::RepoSceneCache::getContentHash(const QString &key)
+{
+	return key.section('_', 0, 0);
+}
+
+QString repo::gui::RepoSceneCache::getSignature(const QStringList &filePaths)
+{
+	QCryptographicHash hash(QCryptographicHash::Sha1);
+	for (int i = 0; i < filePaths.size(); ++i)
+	{
+		const QFileInfo info(filePaths[i]);
+		hash.addData(filePaths[i].toUtf8());
+		if (info.isFile())
+			hash.addData(QByteArray::number(info.size()) + ":" + 
+				QByteArray::number(info.lastModified().toMSecsSinceEpoch()));
+		hash.addData("\n", 1);
+	}
+	return hash.result().toHex();
+}
@@ -0,0 +1,149 @@
+/**
+ *  Copyright (C) 2014 3D Repo Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef REPO_SCENE_CACHE_H
+#define REPO_SCENE_CACHE_H
+
+//------------------------------------------------------------------------------
+#include <QString>
+#include <QStringList>
+#include <QSettings>
+//------------------------------------------------------------------------------
+#include "graph/repo_graph_scene.h"
+//------------------------------------------------------------------------------
+#include "repo_meshindexcache.h"
+//------------------------------------------------------------------------------
+
+namespace repo {
+namespace gui {
+
+/*!
+ * Persistent on-disk cache of imported 3D files stored under the user cache
+ * directory. Each entry is the compact binary (BSON) serialisation of all the
+ * nodes of the scene graph created out of a file, ie its geometry, materials,
+ * raw textures and transformation tree, so that reopening an unchanged file
+ * skips Assimp import entirely. Entries are keyed by the content hash of the
+ * file, which is recomputed only if its path, size or modification time
+ * change, and are evicted in least recently used order above a size limit.
+ *
+ * Files the import read besides the main one, such as external textures or
+ * material libraries, are recorded along with each entry, which is dropped
+ * as soon as any of them changes. Each entry can also hold the triangle
+ * lists derived from its meshes, see RepoMeshIndexCache, so that a restored
+ * scene is not simplified nor reordered again either.
+ */
+class RepoSceneCache
+{
+
+public :
+
+	static const QString REPO_SETTINGS_SCENE_CACHE_MAX_SIZE;
+
+	//! Default size limit of the cache in megabytes.
+	static const int REPO_SCENE_CACHE_DEFAULT_MAX_SIZE = 2048;
+
+public :
+
+	//! Creates a cache in the default user cache location.
+	RepoSceneCache();
+
+	/*!
+	 * Creates a cache in the given directory limited to the given size in
+	 * megabytes, negative for no limit and 0 to disable caching.
+	 */
+	RepoSceneCache(const QString &directory, int maxSize);
+
+	/*!
+	 * Returns the cache key of the given file imported with the given Assimp
+	 * flags, empty string if the file cannot be read or caching is disabled.
+	 */
+	QString getKey(const QString &filePath, unsigned int flags);
+
+	/*!
+	 * Returns a new scene graph restored from the cache, NULL if there is no
+	 * valid entry for the key or any of its dependencies changed since it
+	 * was stored. The caller takes ownership.
+	 */
+	core::RepoGraphScene *load(const QString &key);
+
+	/*!
+	 * Stores all nodes of the given scene graph under the given key along
+	 * with the state of the files it depends on, missing ones included.
+	 */
+	bool store(
+		const QString &key, 
+		const core::RepoGraphScene *scene,
+		const QStringList &dependencies = QStringList());
+
+	/*!
+	 * Reads the derived triangle lists of the entry of the given key into
+	 * indexCache, false if there are none for its settings.
+	 */
+	bool loadIndices(const QString &key, RepoMeshIndexCache &indexCache);
+
+	//! Stores the derived triangle lists along with the entry of the given key.
+	bool storeIndices(const QString &key, const RepoMeshIndexCache &indexCache);
+
+	//! Removes all entries from the cache.
+	void clear();
+
+	//! Returns the size of all entries in bytes.
+	qint64 getSize();
+
+	//! Returns the size limit of the cache in megabytes, 0 disables caching.
+	static int getMaxSize();
+
+	//! Sets the size limit of the cache in megabytes, 0 disables caching.
+	static void setMaxSize(int megabytes);
+
+private :
+
+	//! Returns the full path of the entry file of the given key.
+	QString getEntryPath(const QString &key) const;
+
+	//! Returns the full path of the triangle lists file of the given key.
+	QString getIndicesPath(const QString &key) const;
+
+	//! Removes both files of the entry of the given key.
+	void removeEntry(const QString &key) const;
+
+	/*!
+	 * Removes least recently used entries until the cache fits its limit,
+	 * along with the remembered hashes of files no entry is left for.
+	 */
+	void evict(QSettings &index);
+
+	//! Returns the file content hash part of the given key.
+	static QString getContentHash(const QString &key);
+
+	//! Returns a hash of the existence, size and modification of the files.
+	static QString getSignature(const QStringList &filePaths);
+
+private :
+
+	//! Directory holding the entries and the index.
+	QString directory;
+
+	//! Size limit in megabytes, negative for no limit.
+	int maxSize;
+
+}; // end class
+
+} // end namespace gui
+} // end namespace repo
+
+#endif // end REPO_SCENE_CACHE_H
@@ -0,0 +1,256 @@
+/**
+ *  Copyright (C) 2014 3D Repo Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "repo_texturecache.h"
+//------------------------------------------------------------------------------
+#include <algorithm>
+#include <iostream>
+//------------------------------------------------------------------------------
+#include <QCryptographicHash>
+#include <QMutexLocker>
+#include <QSettings>
+
+const QString repo::gui::RepoTextureCache::REPO_SETTINGS_TEXTURE_CACHE_MAX_SIZE =
+	"RepoTextureCache/maxSize";
+
+//! Levels are not downsampled below this size in either dimension.
+static const int REPO_TEXTURE_CACHE_MIN_SIZE = 32;
+
+repo::gui::RepoTextureCache::RepoTextureCache()
+	: maxSize((qint64) std::max(0, getMaxSize()) * 1024 * 1024)
+	, useCounter(0)
+	, hitsCount(0)
+	, missesCount(0)
+	, memoryUsage(0)
+{}
+
+repo::gui::RepoTextureCache &repo::gui::RepoTextureCache::instance()
+{
+	static RepoTextureCache cache;
+	return cache;
+}
+
+QByteArray repo::gui::RepoTextureCache::insert(const QImage &image)
+{
+	if (image.isNull())
+		return QByteArray();
+
+	const QByteArray key = getContentKey(image);
+	{
+		QMutexLocker locker(&mutex);
+		QHash<QByteArray, Entry>::iterator it = entries.find(key);
+		if (entries.end() != it)
+		{
+			it.value().lastUsed = ++useCounter;
+			++hitsCount;
+			return key;
+		}
+	}
+
+	//--------------------------------------------------------------------------
+	// Downsampling is done without holding the lock so that several images
+	// can be processed by different threads at the same time.
+	Entry entry;
+	entry.levels = createLevels(image);
+	entry.bytes = 0;
+	entry.references = 0;
+	for (int i = 0; i < entry.levels.size(); ++i)
+		entry.bytes += entry.levels[i].byteCount();
+
+	QMutexLocker locker(&mutex);
+	QHash<QByteArray, Entry>::iterator it = entries.find(key);
+	if (entries.end() != it)
+	{
+		++hitsCount; // inserted by another thread in the meantime
+		it.value().lastUsed = ++useCounter;
+	}
+	else
+	{
+		++missesCount;
+		entry.lastUsed = ++useCounter;
+		entries.insert(key, entry);
+		for (int i = 0; i < entry.levels.size(); ++i)
+			levelKeys.insert(entry.levels[i].cacheKey(), key);
+		memoryUsage += entry.bytes;
+		evict();
+	}
+	return key;
+}
+
+QByteArray repo::gui::RepoTextureCache::findKey(const QImage &image) const
+{
+	QMutexLocker locker(&mutex);
+	return image.isNull() ? QByteArray() : levelKeys.value(image.cacheKey());
+}
+
+QImage repo::gui::RepoTextureCache::getImage(
+	const QByteArray &key,
+	const QSize &viewportSize)
+{
+	QMutexLocker locker(&mutex);
+	QHash<QByteArray, Entry>::iterator it = entries.find(key);
+	if (entries.end() == it || it.value().levels.isEmpty())
+		return QImage();
+	it.value().lastUsed = ++useCounter;
+
+	//--------------------------------------------------------------------------
+	// A texture cannot display more texels than there are pixels on screen,
+	// hence pick the smallest level still covering the viewport.
+	const QVector<QImage> &imageLevels = it.value().levels;
+	int level = 0;
+	if (viewportSize.isValid())
+	{
+		const int required = std::max(viewportSize.width(), viewportSize.height());
+		while (level + 1 < imageLevels.size() &&
+			std::max(imageLevels[level + 1].width(),
+				imageLevels[level + 1].height()) >= required)
+			++level;
+	}
+	return imageLevels[level];
+}
+
+void repo::gui::RepoTextureCache::acquire(const QByteArray &key)
+{
+	QMutexLocker locker(&mutex);
+	QHash<QByteArray, Entry>::iterator it = entries.find(key);
+	if (entries.end() != it)
+	{
+		++it.value().references;
+		it.value().lastUsed = ++useCounter;
+	}
+}
+
+void repo::gui::RepoTextureCache::release(const QByteArray &key)
+{
+	QMutexLocker locker(&mutex);
+	QHash<QByteArray, Entry>::iterator it = entries.find(key);
+	if (entries.end() != it && it.value().references > 0)
+	{
+		--it.value().references;
+		evict();
+	}
+}
+
+qint64 repo::gui::RepoTextureCache::getMemoryUsage() const
+{
+	QMutexLocker locker(&mutex);
+	return memoryUsage;
+}
+
+double repo::gui::RepoTextureCache::getHitRate() const
+{
+	QMutexLocker locker(&mutex);
+	const qint64 total = hitsCount + missesCount;
+	return total > 0 ? (double) hitsCount / total : 0.0;
+}
+
+int repo::gui::RepoTextureCache::getImagesCount() const
+{
+	QMutexLocker locker(&mutex);
+	return entries.size();
+}
+
+void repo::gui::RepoTextureCache::clear()
+{
+	QMutexLocker locker(&mutex);
+	QList<QByteArray> unused;
+	QHash<QByteArray, Entry>::const_iterator it;
+	for (it = entries.begin(); it != entries.end(); ++it)
+		if (0 == it.value().references)
+			unused << it.key();
+	for (int i = 0; i < unused.size(); ++i)
+		remove(unused[i]);
+	hitsCount = 0;
+	missesCount = 0;
+}
+
+int repo::gui::RepoTextureCache::getMaxSize()
+{
+	QSettings settings;
+	return settings.value(
+		REPO_SETTINGS_TEXTURE_CACHE_MAX_SIZE,
+		REPO_TEXTURE_CACHE_DEFAULT_MAX_SIZE).toInt();
+}
+
+void repo::gui::RepoTextureCache::setMaxSize(int megabytes)
+{
+	QSettings settings;
+	settings.setValue(REPO_SETTINGS_TEXTURE_CACHE_MAX_SIZE, megabytes);
+}
+
+QByteArray repo::gui::RepoTextureCache::getContentKey(const QImage &image)
+{
+	QCryptographicHash hash(QCryptographicHash::Sha1);
+	const int header[] = { image.width(), image.height(), (int) image.format() };
+	hash.addData((const char *) header, sizeof(header));
+	hash.addData((const char *) image.constBits(), image.byteCount());
+	return hash.result();
+}
+
+QVector<QImage> repo::gui::RepoTextureCache::createLevels(const QImage &image)
+{
+	QVector<QImage> imageLevels;
+	imageLevels << image;
+	QSize size = image.size();
+	while (size.width() / 2 >= REPO_TEXTURE_CACHE_MIN_SIZE &&
+		size.height() / 2 >= REPO_TEXTURE_CACHE_MIN_SIZE)
+	{
+		size /= 2;
+		imageLevels << imageLevels.last().scaled(
+			size, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+	}
+	return imageLevels;
+}
+
+void repo::gui::RepoTextureCache::evict()
+{
+	// Acquired images are never evicted, the cache can exceed its limit if 
+	// the open windows use more than that.
+	int evictedCount = 0;
+	const qint64 usageBefore = memoryUsage;
+	while (memoryUsage > maxSize)
+	{
+		QHash<QByteArray, Entry>::const_iterator oldest = entries.end();
+		QHash<QByteArray, Entry>::const_iterator it;
+		for (it = entries.begin(); it != entries.end(); ++it)
+			if (0 == it.value().references && 
+				(entries.end() == oldest || it.value().lastUsed < oldest.value().lastUsed))
+				oldest = it;
+		if (entries.end() == oldest)
+			break;
+		const QByteArray key = oldest.key();
+		remove(key);
+		++evictedCount;
+	}
+	if (evictedCount > 0)
+	{
+		std::cout << "Texture cache: evicted " << evictedCount << " images, ";
+		std::cout << (usageBefore - memoryUsage) / (1024 * 1024) << " MB freed";
+		std::cout << std::endl;
+	}
+}
+
+void repo::gui::RepoTextureCache::remove(const QByteArray &key)
+{
+	QHash<QByteArray, Entry>::iterator it = entries.find(key);
+	if (entries.end() == it)
+		return;
+	for (int i = 0; i < it.value().levels.size(); ++i)
+		levelKeys.remove(it.value().levels[i].cacheKey());
+	memoryUsage -= it.value().bytes;
+	entries.erase(it);
+}
@@ -0,0 +1,172 @@
+/**
+ *  Copyright (C) 2014 3D Repo Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef REPO_TEXTURE_CACHE_H
+#define REPO_TEXTURE_CACHE_H
+
+//------------------------------------------------------------------------------
+#include <QByteArray>
+#include <QHash>
+#include <QImage>
+#include <QMutex>
+#include <QSize>
+#include <QString>
+#include <QVector>
+//------------------------------------------------------------------------------
+
+namespace repo {
+namespace gui {
+
+/*!
+ * Process-wide cache of decoded texture images keyed by a hash of their
+ * content, so that the same image loaded by several materials, files or
+ * revisions is kept only once. Each image is stored along with a chain of
+ * downsampled levels from which every window picks the level its own
+ * viewport can actually display.
+ *
+ * Windows acquire the images their world uses and release them once the
+ * world is released. Images no longer acquired by any window are evicted
+ * in least recently used order whenever the cache exceeds getMaxSize().
+ */
+class RepoTextureCache
+{
+
+public :
+
+	static const QString REPO_SETTINGS_TEXTURE_CACHE_MAX_SIZE;
+
+	//! Default size limit of the cache in megabytes.
+	static const int REPO_TEXTURE_CACHE_DEFAULT_MAX_SIZE = 512;
+
+public :
+
+	//! Returns the single process-wide instance.
+	static RepoTextureCache &instance();
+
+	/*!
+	 * Adds the given image unless an identical one is already cached and
+	 * returns its content key. Downsampled levels are generated in the
+	 * calling thread, hence this is to be called from workers and not from
+	 * the GUI thread.
+	 */
+	QByteArray insert(const QImage &image);
+
+	/*!
+	 * Returns the key of the cached image the given image or any of its
+	 * levels shares its data with, an empty key if there is none.
+	 */
+	QByteArray findKey(const QImage &image) const;
+
+	/*!
+	 * Returns the smallest cached level of the given image that still covers
+	 * the given viewport size, the full image if the size is invalid and a
+	 * null image if the key is not cached.
+	 */
+	QImage getImage(const QByteArray &key, const QSize &viewportSize = QSize());
+
+	//! Keeps the image of the given key from being evicted until released.
+	void acquire(const QByteArray &key);
+
+	//! Releases an image acquired before, it might be evicted from then on.
+	void release(const QByteArray &key);
+
+	//! Returns the number of bytes held by all cached levels of all images.
+	qint64 getMemoryUsage() const;
+
+	//! Returns the ratio of insertions which were already cached, [0, 1].
+	double getHitRate() const;
+
+	//! Returns the number of distinct images in the cache.
+	int getImagesCount() const;
+
+	//! Removes all images not acquired by any window, resets the statistics.
+	void clear();
+
+	//! Returns the size limit of the cache in megabytes.
+	static int getMaxSize();
+
+	//! Sets the size limit of the cache in megabytes.
+	static void setMaxSize(int megabytes);
+
+private :
+
+	//! Cached image with its downsampled levels.
+	struct Entry
+	{
+		//! Full resolution image followed by its downsampled levels.
+		QVector<QImage> levels;
+
+		//! Bytes held by all levels.
+		qint64 bytes;
+
+		//! Number of windows which acquired the image.
+		int references;
+
+		//! Value of the use counter when last used.
+		qint64 lastUsed;
+	};
+
+	//! Private constructor, use instance() instead.
+	RepoTextureCache();
+
+	//! Returns a content based key of the given image.
+	static QByteArray getContentKey(const QImage &image);
+
+	//! Returns the image followed by its downsampled levels.
+	static QVector<QImage> createLevels(const QImage &image);
+
+	/*!
+	 * Evicts least recently used images which are not acquired until the
+	 * cache fits its size limit. Has to be called with the mutex locked.
+	 */
+	void evict();
+
+	//! Removes the entry of the given key. Has to be called with the mutex locked.
+	void remove(const QByteArray &key);
+
+private :
+
+	//! Cached images keyed by content.
+	QHash<QByteArray, Entry> entries;
+
+	//! Content keys by QImage::cacheKey() of every cached level.
+	QHash<qint64, QByteArray> levelKeys;
+
+	//! Size limit in bytes.
+	qint64 maxSize;
+
+	//! Incremented on every use to order images by recency.
+	qint64 useCounter;
+
+	//! Number of insertions of images that were already cached.
+	qint64 hitsCount;
+
+	//! Number of insertions of images that were not cached yet.
+	qint64 missesCount;
+
+	//! Bytes held by all cached levels.
+	qint64 memoryUsage;
+
+	//! Guards all of the above, the cache is shared by loading threads.
+	mutable QMutex mutex;
+
+}; // end class
+
+} // end namespace gui
+} // end namespace repo
+
+#endif // end REPO_TEXTURE_CACHE_H
@@ -0,0 +1,81 @@
+/**
+ *  Copyright (C) 2014 3D Repo Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "repo_threadpool.h"
+#include <algorithm>
+
+namespace {
+
+//! Runnable that keeps claiming the next free index until the range is exhausted.
+class RepoParallelForRunnable : public QRunnable
+{
+
+public :
+
+	RepoParallelForRunnable(
+		QAtomicInt *next,
+		int count,
+		const std::function<void(int)> *task)
+		: next(next)
+		, count(count)
+		, task(task) {}
+
+	void run()
+	{
+		for (int i = next->fetchAndAddOrdered(1); i < count;
+			i = next->fetchAndAddOrdered(1))
+			(*task)(i);
+	}
+
+private :
+
+	QAtomicInt *next;
+
+	const int count;
+
+	const std::function<void(int)> *task;
+};
+
+} // end anonymous namespace
+
+void repo::gui::RepoThreadPool::parallelFor(
+	int count,
+	const std::function<void(int)> &task,
+	int maxThreadCount)
+{
+	if (count <= 0)
+		return;
+
+	if (maxThreadCount <= 0)
+		maxThreadCount = QThread::idealThreadCount();
+	const int threadCount = std::min(count, std::max(1, maxThreadCount));
+
+	if (1 == threadCount)
+	{
+		for (int i = 0; i < count; ++i)
+			task(i);
+	}
+	else
+	{
+		QAtomicInt next(0);
+		QThreadPool pool;
+		pool.setMaxThreadCount(threadCount);
+		for (int i = 0; i < threadCount; ++i)
+			pool.start(new RepoParallelForRunnable(&next, count, &task));
+		pool.waitForDone();
+	}
+}
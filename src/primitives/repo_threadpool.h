@@ -0,0 +1,61 @@
+/**
+ *  Copyright (C) 2014 3D Repo Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef REPO_THREAD_POOL_H
+#define REPO_THREAD_POOL_H
+
+//------------------------------------------------------------------------------
+#include <functional>
+//------------------------------------------------------------------------------
+#include <QAtomicInt>
+#include <QRunnable>
+#include <QThread>
+#include <QThreadPool>
+//------------------------------------------------------------------------------
+
+namespace repo {
+namespace gui {
+
+/*!
+ * Data-parallel helper for CPU bound loops such as per-mesh conversion.
+ * Every call creates its own private QThreadPool so that loops started from
+ * within a worker running on QThreadPool::globalInstance() can never starve
+ * the global pool nor each other.
+ */
+class RepoThreadPool
+{
+
+public :
+
+	/*!
+	 * Calls task(i) for every i in [0, count) using at most maxThreadCount
+	 * threads and blocks until all of them are done. Indices are handed out
+	 * dynamically so that uneven tasks balance out. Results should be written
+	 * into pre-allocated slots indexed by i to keep the output deterministic.
+	 * Non-positive maxThreadCount defaults to QThread::idealThreadCount().
+	 */
+	static void parallelFor(
+		int count,
+		const std::function<void(int)> &task,
+		int maxThreadCount = 0);
+
+}; // end class
+
+} // end namespace gui
+} // end namespace repo
+
+#endif // end REPO_THREAD_POOL_H
@@ -37,6 +37,10 @@
 #include "dialogs/repodialogoculus.h"
 #include "dialogs/repodialogusermanager.h"
 #include "primitives/repo_fontawesome.h"
+#include "primitives/repo_documentcache.h"
+#include "primitives/repo_memory.h"
+#include "primitives/repo_scenecache.h"
+#include "primitives/repo_texturecache.h"
 #include "oculus/repo_oculus.h"
 
 
@@ -162,6 +166,9 @@ repo::gui::RepoGUI::RepoGUI(QWidget *parent) :
     QObject::connect(ui->actionUserManager, SIGNAL(triggered()), this, SLOT(openUserManager()));
     ui->actionUserManager->setIcon(RepoDialogUserManager::getIcon());
 
+    // Clear Scene Cache
+    QObject::connect(ui->actionClearSceneCache, SIGNAL(triggered()), this, SLOT(clearSceneCache()));
+
 
 
     //--------------------------------------------------------------------------
@@ -238,6 +245,29 @@ repo::gui::RepoGUI::~RepoGUI()
 //
 //------------------------------------------------------------------------------
 
+void repo::gui::RepoGUI::clearSceneCache()
+{
+    RepoSceneCache sceneCache;
+    std::cout << "Scene cache cleared, ";
+    std::cout << RepoMemory::toMegabytes(sceneCache.getSize()) << " MB freed";
+    std::cout << std::endl;
+    sceneCache.clear();
+
+    RepoDocumentCache documentCache;
+    std::cout << "Document cache cleared, ";
+    std::cout << RepoMemory::toMegabytes(documentCache.getSize()) << " MB freed";
+    std::cout << std::endl;
+    documentCache.clear();
+
+    // Textures of open windows stay.
+    RepoTextureCache &textureCache = RepoTextureCache::instance();
+    const qint64 textureBytes = textureCache.getMemoryUsage();
+    textureCache.clear();
+    std::cout << "Texture cache cleared, ";
+    std::cout << RepoMemory::toMegabytes(textureBytes - textureCache.getMemoryUsage());
+    std::cout << " MB freed" << std::endl;
+}
+
 void repo::gui::RepoGUI::commit()
 {
     RepoMdiSubWindow *activeWindow = ui->mdiArea->activeSubWindow();
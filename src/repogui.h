@@ -55,6 +55,9 @@ public:
 
 public slots:
 
+    //! Removes all entries from the local caches of imported files, fetched documents and unused textures.
+    void clearSceneCache();
+
     //! Shows a commit dialog based on currently active 3D window.
     void commit();
 
@@ -18,6 +18,8 @@
 
 #include "repo_glcwidget.h"
 #include "../primitives/repo_fontawesome.h"
+#include "../primitives/repo_glcmesh.h"
+#include "../primitives/repo_texturecache.h"
 //------------------------------------------------------------------------------
 #include <iostream>
 //------------------------------------------------------------------------------
@@ -124,6 +126,7 @@ repo::gui::RepoGLCWidget::~RepoGLCWidget()
 	glcUICollection.clear();
 	glcViewCollection.clear();
 	glcWorld.clear();
+	releaseTextures();
 		
     GLC_SelectionMaterial::deleteShader(context());
 
@@ -282,6 +285,13 @@ void repo::gui::RepoGLCWidget::paintGL()
 		if (shaderID && !GLC_State::isInSelectionMode())
 			GLC_Shader::use(shaderID);
 
+		//----------------------------------------------------------------------
+		// Levels of detail are selected by their error projected on screen.
+		RepoGLCMesh::setLodViewport(
+			glcViewport.minimumDynamicPixelCullingRatio(),
+			qMax(width(), height()));
+		glcWorld.collection()->setLodUsage(true, &glcViewport);
+
 		// Display opaque instanced objects
 		glcWorld.render(0, renderingFlag);		
 		if (GLC_State::glslUsed())
@@ -431,6 +441,7 @@ void repo::gui::RepoGLCWidget::paintInfo()
 void repo::gui::RepoGLCWidget::resizeGL(int width, int height)
 {
 	glcViewport.setWinGLSize(width, height); // Compute window aspect ratio
+	updateTextureLevels();
 }
 
 void repo::gui::RepoGLCWidget::reframe(const GLC_BoundingBox& boundingBox)
@@ -672,10 +683,156 @@ void repo::gui::RepoGLCWidget::setRepoScene(core::RepoGraphScene *repoScene)
 
 void repo::gui::RepoGLCWidget::setGLCWorld(GLC_World glcWorld)
 {
+	// Keep the camera the user might have already moved in a streamed preview.
+	const bool isPreviewed = this->glcWorld.rootOccurence()->childCount() > 0;
+	glcMeshes.clear();
+	glcMeshesIds.clear();
+	glcOccurrences.clear();
+
+	// Images of the previous world are released only once those of the new
+	// one are acquired so that the ones they share are not evicted.
+	const QList<QByteArray> previousKeys = textureKeys.values();
+	textureKeys.clear();
+	textureLevelSizes.clear();
+
 	this->glcWorld = glcWorld;
 	glcViewport.setDistMinAndMax(this->glcWorld.boundingBox());	
-	setCamera(ISO);
+	if (!isPreviewed)
+		setCamera(ISO);
 	extractMeshes(this->glcWorld.rootOccurence());
+	updateTextureLevels();
+
+	RepoTextureCache &textureCache = RepoTextureCache::instance();
+	for (int i = 0; i < previousKeys.size(); ++i)
+		textureCache.release(previousKeys[i]);
+}
+
+void repo::gui::RepoGLCWidget::mergeGLCWorld(GLC_World &glcChunk)
+{
+	GLC_StructOccurence *root = glcWorld.rootOccurence();
+	const int previousCount = root->childCount();
+	glcWorld.mergeWithAnotherWorld(glcChunk);
+	glcViewport.setDistMinAndMax(glcWorld.boundingBox());	
+	if (0 == previousCount)
+		setCamera(ISO);
+
+	// Only the newly merged subtrees need to be indexed.
+	for (int i = previousCount; i < root->childCount(); ++i)
+		extractMeshes(root->child(i));
+	updateTextureLevels();
+	if (isWireframe)
+		setMode(GL_LINE);
+	if (isWireframe || glc::WireRenderFlag == renderingFlag)
+		createPolygonWireframes();
+
+	// The chunk is released here, on the GUI thread, as the merged subtrees
+	// share its representations. The loading thread only destroys an empty
+	// world afterwards.
+	glcChunk.clear();
+	updateGL();
+}
+
+void repo::gui::RepoGLCWidget::setGLCTexture(
+	const QString &name, 
+	const QImage &image)
+{
+	// Replacing a texture deletes the placeholder's GL texture.
+	makeCurrent();
+	RepoTextureCache &textureCache = RepoTextureCache::instance();
+	QImage level = image;
+	const QByteArray key = textureCache.findKey(image);
+	if (!key.isEmpty())
+	{
+		textureCache.acquire(key);
+		const QByteArray previousKey = textureKeys.value(name);
+		if (!previousKey.isEmpty())
+			textureCache.release(previousKey);
+		textureKeys.insert(name, key);
+		const QImage cachedLevel = textureCache.getImage(key, size());
+		if (!cachedLevel.isNull())
+			level = cachedLevel;
+	}
+	textureLevelSizes.insert(name, level.size());
+
+	QSet<GLC_Material*> visited;
+	QHash<QString, GLC_Mesh*>::iterator it;
+	for (it = glcMeshes.begin(); it != glcMeshes.end(); ++it)
+	{
+		const QSet<GLC_Material*> materials = it.value()->materialSet();
+		QSet<GLC_Material*>::const_iterator mit;
+		for (mit = materials.begin(); mit != materials.end(); ++mit)
+		{
+			GLC_Material *material = *mit;
+			if (!visited.contains(material) && material->hasTexture() && 
+				material->textureHandle()->fileName() == name)
+				material->setTexture(new GLC_Texture(level, name));
+			visited.insert(material);
+		}
+	}
+	updateGL();
+}
+
+void repo::gui::RepoGLCWidget::updateTextureLevels()
+{
+	// Each window binds the smallest level covering its own viewport, the
+	// full resolution images stay in the cache while acquired.
+	RepoTextureCache &textureCache = RepoTextureCache::instance();
+	QSet<GLC_Material*> visited;
+	bool isCurrent = false;
+	QHash<QString, GLC_Mesh*>::iterator it;
+	for (it = glcMeshes.begin(); it != glcMeshes.end(); ++it)
+	{
+		const QSet<GLC_Material*> materials = it.value()->materialSet();
+		QSet<GLC_Material*>::const_iterator mit;
+		for (mit = materials.begin(); mit != materials.end(); ++mit)
+		{
+			GLC_Material *material = *mit;
+			if (visited.contains(material) || !material->hasTexture())
+				continue;
+			visited.insert(material);
+
+			const QString name = material->textureHandle()->fileName();
+			QByteArray key = textureKeys.value(name);
+			if (key.isEmpty())
+			{
+				// Only images not uploaded yet can be looked up.
+				key = textureCache.findKey(
+					material->textureHandle()->imageOfTexture());
+				if (key.isEmpty())
+					continue;
+				textureCache.acquire(key);
+				textureKeys.insert(name, key);
+			}
+
+			// Uploaded textures might have dropped their image, the size of
+			// the level bound last is compared instead.
+			const QImage level = textureCache.getImage(key, size());
+			const QImage current = material->textureHandle()->imageOfTexture();
+			const QSize currentSize = current.isNull()
+				? textureLevelSizes.value(name)
+				: current.size();
+			if (level.isNull() || level.size() == currentSize)
+				continue;
+			if (!isCurrent)
+			{
+				// Replacing a texture deletes its GL texture.
+				makeCurrent();
+				isCurrent = true;
+			}
+			material->setTexture(new GLC_Texture(level, name));
+			textureLevelSizes.insert(name, level.size());
+		}
+	}
+}
+
+void repo::gui::RepoGLCWidget::releaseTextures()
+{
+	RepoTextureCache &textureCache = RepoTextureCache::instance();
+	QHash<QString, QByteArray>::const_iterator it;
+	for (it = textureKeys.begin(); it != textureKeys.end(); ++it)
+		textureCache.release(it.value());
+	textureKeys.clear();
+	textureLevelSizes.clear();
 }
 
 //------------------------------------------------------------------------------
@@ -711,6 +868,26 @@ GLC_Mesh* repo::gui::RepoGLCWidget::getGLCMesh(const QString &name) const
 	return glcMesh;
 }
 
+void repo::gui::RepoGLCWidget::setRenderingFlag(glc::RenderFlag renderingFlag)
+{
+	this->renderingFlag = renderingFlag;
+	if (glc::WireRenderFlag == renderingFlag)
+		createPolygonWireframes();
+}
+
+void repo::gui::RepoGLCWidget::createPolygonWireframes()
+{
+	// Vertex data might have been moved into VBOs already.
+	makeCurrent();
+	QHash<QString, GLC_Mesh*>::iterator it;
+	for (it = glcMeshes.begin(); it != glcMeshes.end(); ++it)
+	{
+		RepoGLCMesh *repoMesh = dynamic_cast<RepoGLCMesh*>(it.value());
+		if (repoMesh && !repoMesh->hasPolygonWireframe())
+			repoMesh->createPolygonWireframe();
+	}
+}
+
 QImage repo::gui::RepoGLCWidget::renderQImage(int w, int h)
 {
 	// See https://bugreports.qt-project.org/browse/QTBUG-33186
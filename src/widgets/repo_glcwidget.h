@@ -188,12 +188,31 @@ public :
     //! Sets the GLC World for this widget which is used for rendering purposes.
 	void setGLCWorld(GLC_World);
 
+	/*!
+	 * Adds all occurrences of the given world to the one being rendered, used
+	 * to display parts of a scene while it is still being loaded. The camera
+	 * is reset only for the first merged world. The given world is cleared.
+	 */
+	void mergeGLCWorld(GLC_World &);
+
+	/*!
+	 * Binds a texture decoded after the world has been set to all materials
+	 * with a placeholder texture of the same name.
+	 */
+	void setGLCTexture(const QString &name, const QImage &image);
+
 	//! Sets the globally applied shader from the shaders list.
     void setShader(GLuint id) { shaderID = id; }
 
 	//! Sets the rendering flag.
-	inline void setRenderingFlag(glc::RenderFlag renderingFlag) 
-    { this->renderingFlag = renderingFlag; }
+	/*!
+	 * Polygon wireframes of the meshes are only created the first time the
+	 * glc::WireRenderFlag is requested.
+	 */
+	void setRenderingFlag(glc::RenderFlag renderingFlag);
+
+	//! Creates the polygon wireframes of all meshes which do not have one yet.
+	void createPolygonWireframes();
 
 	//! Sets the rendering mode (GL_POINT, GL_LINE, GL_FILL)
 	inline void setMode(GLenum mode)
@@ -272,6 +291,16 @@ protected :
 	//! Recursively extracts meshes from a given occurrence. Call with a root node.
 	void extractMeshes(GLC_StructOccurence*);
 
+	/*!
+	 * Binds the level of every texture of the rendered meshes that is fit for
+	 * the size of this widget. Images seen for the first time are acquired
+	 * from RepoTextureCache until releaseTextures() is called.
+	 */
+	void updateTextureLevels();
+
+	//! Releases the images acquired from RepoTextureCache.
+	void releaseTextures();
+
     //--------------------------------------------------------------------------
 	//
 	// Private variables
@@ -311,6 +340,12 @@ protected :
 	//! Dictionary of occurrences pointed to by their associated unique name.
 	QHash<QString, GLC_StructOccurence *> glcOccurrences;
 
+	//! Keys of the images acquired from RepoTextureCache by texture name.
+	QHash<QString, QByteArray> textureKeys;
+
+	//! Sizes of the currently bound texture levels by texture name.
+	QHash<QString, QSize> textureLevelSizes;
+
 	//! True if wireframe is to be rendered, false otherwise.
 	bool isWireframe;
 
@@ -198,6 +198,14 @@ repo::gui::RepoMdiSubWindow * repo::gui::RepoMdiArea::addSubWindow(
 	connect(worker, SIGNAL(finished(repo::core::RepoGraphScene *, GLC_World &)),
 		repoSubWindow, SLOT(finishedLoading(repo::core::RepoGraphScene *, GLC_World &)));
 	connect(worker, SIGNAL(progress(int, int)), repoSubWindow, SLOT(progress(int, int)));
+	connect(worker, SIGNAL(textureLoaded(const QString &, const QImage &)),
+		repoSubWindow, SLOT(textureLoaded(const QString &, const QImage &)));
+	// Blocking as the streamed chunk is only valid for the duration of the call.
+	connect(worker, SIGNAL(chunkLoaded(GLC_World &)),
+		repoSubWindow, SLOT(chunkLoaded(GLC_World &)), Qt::BlockingQueuedConnection);
+	connect(repoSubWindow->widget<RepoGLCWidget*>(), 
+		SIGNAL(cameraChangedSignal(const GLC_Camera &)),
+		worker, SLOT(setCamera(const GLC_Camera &)), Qt::DirectConnection);
 
 	QObject::connect(
 		repoSubWindow, &RepoMdiSubWindow::aboutToDelete,
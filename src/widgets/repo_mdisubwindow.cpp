@@ -18,6 +18,7 @@
 #include "repo_mdisubwindow.h"
 #include "repo_glcwidget.h"
 #include "../primitives/repo_fontawesome.h"
+#include "../workers/repo_importscheduler.h"
 
 #include "../oculus/repo_oculus.h"
 
@@ -85,11 +86,18 @@ void repo::gui::RepoMdiSubWindow::setWidget(
 	connect(worker, SIGNAL(finished(repo::core::RepoGraphScene *, GLC_World &)), 
 		this, SLOT(finishedLoading(repo::core::RepoGraphScene *, GLC_World &)));
 	connect(worker, SIGNAL(progress(int, int)), this, SLOT(progress(int, int)));
+	// Blocking as the streamed chunk is only valid for the duration of the call.
+	connect(worker, SIGNAL(chunkLoaded(GLC_World &)), 
+		this, SLOT(chunkLoaded(GLC_World &)), Qt::BlockingQueuedConnection);
+	connect(worker, SIGNAL(textureLoaded(const QString &, const QImage &)),
+		this, SLOT(textureLoaded(const QString &, const QImage &)));
+	connect(this, &RepoMdiSubWindow::aboutToDelete, 
+		worker, &RepoWorkerAssimp::cancel, Qt::DirectConnection);
 	//connect(worker, SIGNAL(error(QString)), this, SLOT(errorString(QString)));
 	
     //--------------------------------------------------------------------------
-	// Fire up the asynchronous calculation.
-	QThreadPool::globalInstance()->start(worker);
+	// Fire up the asynchronous calculation once there is enough memory.
+	RepoImportScheduler::instance().enqueue(worker, filePath, this);
 }
 
 void repo::gui::RepoMdiSubWindow::setWidget(QWidget * widget)
@@ -143,6 +151,40 @@ void repo::gui::RepoMdiSubWindow::finishedLoading(
     }
 }
 
+void repo::gui::RepoMdiSubWindow::chunkLoaded(GLC_World &glcChunk)
+{
+	RepoGLCWidget *widget = dynamic_cast<RepoGLCWidget*>(this->widget());
+	if (widget)
+		widget->mergeGLCWorld(glcChunk);
+}
+
+void repo::gui::RepoMdiSubWindow::textureLoaded(
+	const QString &name, 
+	const QImage &image)
+{
+	RepoGLCWidget *widget = dynamic_cast<RepoGLCWidget*>(this->widget());
+	if (widget)
+		widget->setGLCTexture(name, image);
+}
+
+void repo::gui::RepoMdiSubWindow::setQueuePosition(int position)
+{
+	if (position > 0)
+	{
+		progressBar->setRange(0, 0);
+		progressBar->setFormat(tr("Queued: %1").arg(position));
+		progressBar->setTextVisible(true);
+		progressBar->show();
+	}
+	else
+	{
+		progressBar->setRange(0, 100);
+		progressBar->setValue(0);
+		progressBar->resetFormat();
+		progressBar->setTextVisible(false);
+	}
+}
+
 void repo::gui::RepoMdiSubWindow::progress(int value, int maximum)
 {
 	if (progressBar->maximum() != maximum)
@@ -119,12 +119,24 @@ public slots :
 	//! Sets the two scene representations on the widget.
 	void finishedLoading(repo::core::RepoGraphScene *, GLC_World &);
 
+	//! Adds a streamed chunk of a scene being loaded to the 3D widget.
+	void chunkLoaded(GLC_World &);
+
+	//! Binds a texture decoded after loading to the 3D widget.
+	void textureLoaded(const QString &name, const QImage &image);
+
 	/*! 
 	 * Updates the current state of the progress bar with the values specified.
 	 * This method makes the progress bar visible unless the value is non-zero
 	 * and equals the maximum in which case the progress bar is hidden.
 	 */
 	void progress(int value, int maximum);
+
+	/*!
+	 * Shows the position of the file import in the import queue in the
+	 * progress bar, zero when the import has been started.
+	 */
+	void setQueuePosition(int position);
 	
 private :
 
@@ -0,0 +1,274 @@
+/**
+ *  Copyright (C) 2014 3D Repo Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "repo_batchimport.h"
+#include "repo_importscheduler.h"
+#include "repo_worker_assimp.h"
+#include "../primitives/repo_memory.h"
+#include "../primitives/repo_threadpool.h"
+//------------------------------------------------------------------------------
+#include <cstring>
+#include <iostream>
+#include <vector>
+//------------------------------------------------------------------------------
+#include <QCommandLineOption>
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QImage>
+#include <QJsonDocument>
+#include <QTime>
+//------------------------------------------------------------------------------
+#include "assimpwrapper.h"
+
+const QString repo::gui::RepoBatchImport::REPO_BATCH_SWITCH = "--batch";
+
+repo::gui::RepoBatchImport::RepoBatchImport(
+	const QStringList &filePaths,
+	const QString &outputDirectory,
+	const QString &exportFormat,
+	int jobsCount,
+	unsigned int postProcessingFlags)
+	: filePaths(filePaths)
+	, outputDirectory(QDir(outputDirectory).absolutePath())
+	, exportFormat(exportFormat)
+	, jobsCount(jobsCount > 0 
+		? jobsCount 
+		: RepoImportScheduler::getMaxConcurrentImports())
+	, postProcessingFlags(postProcessingFlags)
+{}
+
+bool repo::gui::RepoBatchImport::isBatch(int argc, char *argv[])
+{
+	for (int i = 1; i < argc; ++i)
+		if (REPO_BATCH_SWITCH == argv[i])
+			return true;
+	return false;
+}
+
+int repo::gui::RepoBatchImport::exec(const QStringList &arguments)
+{
+	QCommandLineParser parser;
+	parser.setApplicationDescription(
+		"Imports 3D files into the scene cache without opening a window.");
+	parser.addHelpOption();
+	const QCommandLineOption batchOption(
+		"batch", "Runs the import without a window.");
+	const QCommandLineOption outOption(
+		"out", "Directory of the scene cache and exported files.", "directory");
+	const QCommandLineOption formatOption(
+		"format", "Also exports every file in the given format, e.g. obj.", "extension");
+	const QCommandLineOption jobsOption(
+		"jobs", "Number of files imported at the same time.", "count");
+	parser.addOption(batchOption);
+	parser.addOption(outOption);
+	parser.addOption(formatOption);
+	const QCommandLineOption flagsOption(
+		"flags", "Assimp post processing flags, e.g. 0x8B, 0 by default.", "flags");
+	parser.addOption(jobsOption);
+	parser.addOption(flagsOption);
+	parser.addPositionalArgument("files", "3D files to import.", "files...");
+	parser.process(arguments);
+
+	const QStringList files = expandWildcards(parser.positionalArguments());
+	bool isFlagsValid = true;
+	const unsigned int postProcessingFlags = parser.isSet(flagsOption) 
+		? parser.value(flagsOption).toUInt(&isFlagsValid, 0)
+		: 0;
+	if (files.isEmpty() || !parser.isSet(outOption) || !isFlagsValid)
+	{
+		std::cerr << parser.helpText().toStdString() << std::endl;
+		return 2;
+	}
+
+	RepoBatchImport batch(
+		files,
+		parser.value(outOption),
+		parser.value(formatOption),
+		parser.value(jobsOption).toInt(),
+		postProcessingFlags);
+	return batch.run();
+}
+
+int repo::gui::RepoBatchImport::run()
+{
+	// The report is the only output on stdout so that it can be parsed.
+	std::streambuf *coutBuffer = std::cout.rdbuf(std::cerr.rdbuf());
+	QDir().mkpath(outputDirectory);
+
+	//--------------------------------------------------------------------------
+	// Every import converts its meshes on several threads as well.
+	QTime time;
+	time.start();
+	std::vector<QJsonObject> reports(filePaths.size());
+	RepoThreadPool::parallelFor(
+		filePaths.size(),
+		[&](int i) { reports[i] = import(filePaths[i]); },
+		jobsCount);
+	const int totalTime = time.elapsed();
+	std::cout.rdbuf(coutBuffer);
+
+	//--------------------------------------------------------------------------
+	// Report
+	QJsonArray files;
+	int failedCount = 0;
+	for (unsigned int i = 0; i < reports.size(); ++i)
+	{
+		if (!reports[i].value("succeeded").toBool())
+			++failedCount;
+		files.append(reports[i]);
+	}
+	QJsonObject report;
+	report["files"] = files;
+	report["failed"] = failedCount;
+	report["jobs"] = jobsCount;
+	report["flags"] = (double) postProcessingFlags;
+	report["totalMs"] = totalTime;
+	report["peakResidentMB"] = 
+		RepoMemory::toMegabytes(RepoMemory::getPeakResidentBytes());
+	report["physicalMB"] = 
+		RepoMemory::toMegabytes(RepoMemory::getPhysicalBytes());
+	std::cout << QJsonDocument(report).toJson().constData() << std::flush;
+	return failedCount > 0 ? 1 : 0;
+}
+
+QStringList repo::gui::RepoBatchImport::expandWildcards(const QStringList &filePaths)
+{
+	QStringList expanded;
+	for (int i = 0; i < filePaths.size(); ++i)
+	{
+		const QFileInfo fileInfo(filePaths[i]);
+		if (!fileInfo.fileName().contains('*') && !fileInfo.fileName().contains('?'))
+			expanded << filePaths[i];
+		else
+		{
+			const QDir directory = fileInfo.absoluteDir();
+			const QStringList names = directory.entryList(
+				QStringList(fileInfo.fileName()), QDir::Files, QDir::Name);
+			for (int j = 0; j < names.size(); ++j)
+				expanded << directory.filePath(names[j]);
+		}
+	}
+	return expanded;
+}
+
+QJsonObject repo::gui::RepoBatchImport::import(const QString &filePath)
+{
+	QJsonObject report;
+	const QFileInfo fileInfo(filePath);
+	if (!fileInfo.isFile())
+	{
+		std::cerr << "File " << filePath.toStdString() << " not found." << std::endl;
+		report["file"] = filePath;
+		report["succeeded"] = false;
+		return report;
+	}
+
+	//--------------------------------------------------------------------------
+	// Run the GUI pipeline in this thread, the scene is handed over by the 
+	// finished signal which is emitted directly.
+	RepoWorkerAssimp worker(fileInfo.absoluteFilePath(), postProcessingFlags);
+	worker.setSceneCacheDirectory(outputDirectory);
+	QString exportPath;
+	int exportTime = 0;
+	QObject::connect(&worker, &RepoWorkerAssimp::finished, 
+		[&](core::RepoGraphScene *scene, GLC_World &) {
+			if (scene && !exportFormat.isEmpty())
+			{
+				QTime time;
+				time.start();
+				exportPath = exportScene(filePath, scene);
+				exportTime = time.elapsed();
+			}
+			delete scene;
+		});
+	worker.run();
+
+	report = QJsonObject::fromVariantMap(worker.getStatistics());
+	report["file"] = fileInfo.absoluteFilePath();
+	report["sizeMB"] = RepoMemory::toMegabytes(fileInfo.size());
+	report["estimatedPeakMB"] = RepoMemory::toMegabytes(
+		RepoImportScheduler::estimatePeakBytes(filePath));
+	if (!exportFormat.isEmpty())
+	{
+		report["export"] = exportPath;
+		report["exportMs"] = exportTime;
+		if (exportPath.isEmpty())
+			report["succeeded"] = false;
+	}
+	// Resident memory is shared by the files imported at the same time.
+	report["residentMB"] = 
+		RepoMemory::toMegabytes(RepoMemory::getCurrentResidentBytes());
+	report["peakResidentMB"] = 
+		RepoMemory::toMegabytes(RepoMemory::getPeakResidentBytes());
+	return report;
+}
+
+QString repo::gui::RepoBatchImport::exportScene(
+	const QString &filePath,
+	const core::RepoGraphScene *scene)
+{
+	const QDir directory(outputDirectory);
+	const QString path = directory.filePath(
+		QFileInfo(filePath).completeBaseName() + "." + exportFormat);
+
+	const std::string embeddedTextureExtension = ".jpg";
+	aiScene *assimpScene = new aiScene();
+	assimpScene->mFlags = 0;
+	scene->toAssimp(assimpScene);
+	core::AssimpWrapper exporter;
+	const bool isExported = exporter.exportModel(
+		assimpScene,
+		core::AssimpWrapper::getExportFormatID(exportFormat.toStdString()),
+		path.toStdString(),
+		embeddedTextureExtension);
+
+	//--------------------------------------------------------------------------
+	// Textures
+	// External ones are written as they were read, embedded ones are named 
+	// after their index as referenced by the exporter.
+	if (!isExported)
+		std::cerr << "Export of " << path.toStdString() << " unsuccessful." << std::endl;
+	else
+	{
+		const std::vector<core::RepoNodeTexture *> textures = scene->getTextures();
+		for (size_t i = 0; i < textures.size(); ++i)
+		{
+			core::RepoNodeTexture *texture = textures[i];
+			const std::string name = texture->getName();
+			if (assimpScene->HasTextures())
+			{
+				QImage image = QImage::fromData(
+					(const uchar *) texture->getData(), 
+					texture->getDataSize());
+				image.save(directory.filePath(QString::fromStdString(
+					name.substr(1, name.size()) + embeddedTextureExtension)));
+			}
+			else
+			{
+				QFile file(directory.filePath(QString::fromStdString(name)));
+				QDir().mkpath(QFileInfo(file).absolutePath());
+				if (file.open(QIODevice::WriteOnly))
+					file.write((const char *) texture->getData(), texture->getDataSize());
+			}
+		}
+	}
+	delete assimpScene;
+	return isExported ? path : QString();
+}
@@ -0,0 +1,115 @@
+/**
+ *  Copyright (C) 2014 3D Repo Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef REPO_BATCH_IMPORT_H
+#define REPO_BATCH_IMPORT_H
+
+//------------------------------------------------------------------------------
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QString>
+#include <QStringList>
+//------------------------------------------------------------------------------
+#include "graph/repo_graph_scene.h"
+
+namespace repo {
+namespace gui {
+
+/*!
+ * Headless import of 3D files for conversion farms and benchmarks, started
+ * as 3drepogui --batch a.ifc b.obj --out cache/ without creating any window.
+ * Each file runs through the very same RepoWorkerAssimp pipeline as in the
+ * GUI, several files at a time. The scene graphs are stored in the binary
+ * scene cache in the output directory and optionally exported via Assimp
+ * in the given format. Per file stage timings and memory are printed as a
+ * single JSON document on stdout, the usual log goes to stderr instead.
+ */
+class RepoBatchImport
+{
+
+public :
+
+	//! Command line switch of the batch mode.
+	static const QString REPO_BATCH_SWITCH;
+
+public :
+
+	/*!
+	 * Creates a batch of the given files written to the output directory.
+	 * Empty export format stores only the scene cache, non-positive jobs 
+	 * count defaults to RepoImportScheduler::getMaxConcurrentImports().
+	 * Post processing flags are Assimp aiPostProcessSteps, which are part of
+	 * the scene cache key just as for imports in the GUI.
+	 */
+	RepoBatchImport(
+		const QStringList &filePaths,
+		const QString &outputDirectory,
+		const QString &exportFormat = QString(),
+		int jobsCount = 0,
+		unsigned int postProcessingFlags = 0);
+
+	//! Returns true if the command line asks for the batch mode.
+	static bool isBatch(int argc, char *argv[]);
+
+	/*!
+	 * Parses the command line of the batch mode and runs it. Returns the 
+	 * process exit code, 0 if all files were imported.
+	 */
+	static int exec(const QStringList &arguments);
+
+	//! Imports all the files, prints the report and returns the exit code.
+	int run();
+
+	//! Returns the file paths with wildcards expanded, shells on Windows don't.
+	static QStringList expandWildcards(const QStringList &filePaths);
+
+private :
+
+	//! Imports a single file and returns its report. Reentrant.
+	QJsonObject import(const QString &filePath);
+
+	/*!
+	 * Exports the scene graph in the export format next to its raw textures
+	 * and returns the path of the exported file, empty on failure.
+	 */
+	QString exportScene(
+		const QString &filePath,
+		const core::RepoGraphScene *scene);
+
+private :
+
+	//! Files to be imported.
+	QStringList filePaths;
+
+	//! Directory of the scene cache and of the exported files.
+	QString outputDirectory;
+
+	//! File extension of the export format, empty for no export.
+	QString exportFormat;
+
+	//! Number of files imported at the same time.
+	int jobsCount;
+
+	//! Assimp post processing flags of every import.
+	unsigned int postProcessingFlags;
+
+}; // end class
+
+} // end namespace gui
+} // end namespace repo
+
+#endif // end REPO_BATCH_IMPORT_H
@@ -0,0 +1,154 @@
+/**
+ *  Copyright (C) 2014 3D Repo Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "repo_importscheduler.h"
+#include "../primitives/repo_memory.h"
+#include "../widgets/repo_mdisubwindow.h"
+//------------------------------------------------------------------------------
+#include <algorithm>
+#include <iostream>
+//------------------------------------------------------------------------------
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QSettings>
+#include <QThread>
+#include <QThreadPool>
+
+const QString repo::gui::RepoImportScheduler::REPO_SETTINGS_IMPORT_MEMORY_BUDGET =
+	"RepoImportScheduler/memoryBudget";
+
+repo::gui::RepoImportScheduler::RepoImportScheduler()
+	: runningBytes(0)
+{}
+
+repo::gui::RepoImportScheduler &repo::gui::RepoImportScheduler::instance()
+{
+	static RepoImportScheduler scheduler;
+	return scheduler;
+}
+
+void repo::gui::RepoImportScheduler::enqueue(
+	RepoWorkerAbstract *worker,
+	const QString &filePath,
+	RepoMdiSubWindow *window)
+{
+	RepoQueuedImport import;
+	import.worker = worker;
+	import.filePath = filePath;
+	import.estimatedBytes = estimatePeakBytes(filePath);
+	import.window = window;
+	queue << import;
+	// Queued so that positions are updated once the closed window is gone.
+	connect(window, SIGNAL(destroyed()), this, SLOT(schedule()), 
+		Qt::QueuedConnection);
+	schedule();
+}
+
+qint64 repo::gui::RepoImportScheduler::estimatePeakBytes(const QString &filePath)
+{
+	// Rough peak of the Assimp scene, the GLC world and the scene graph held
+	// at the same time relative to the file size. Text formats expand less
+	// than binary ones, IFC geometry is tessellated on import.
+	const QFileInfo fileInfo(filePath);
+	const QString suffix = fileInfo.suffix().toLower();
+	int multiplier = 10;
+	if ("ifc" == suffix)
+		multiplier = 25;
+	else if ("obj" == suffix || "stl" == suffix || "ply" == suffix || "off" == suffix)
+		multiplier = 6;
+	else if ("dae" == suffix || "x3d" == suffix || "xml" == suffix)
+		multiplier = 8;
+	else if ("fbx" == suffix || "3ds" == suffix || "blend" == suffix || "lwo" == suffix)
+		multiplier = 12;
+	return REPO_IMPORT_BASE_BYTES + fileInfo.size() * multiplier;
+}
+
+qint64 repo::gui::RepoImportScheduler::getMemoryBudget()
+{
+	QSettings settings;
+	const qint64 megabytes = 
+		settings.value(REPO_SETTINGS_IMPORT_MEMORY_BUDGET, 0).toLongLong();
+	if (megabytes > 0)
+		return megabytes * 1024 * 1024;
+	const qint64 physicalBytes = RepoMemory::getPhysicalBytes();
+	return physicalBytes > 0 ? physicalBytes / 2 : (qint64) 2048 * 1024 * 1024;
+}
+
+void repo::gui::RepoImportScheduler::setMemoryBudget(int megabytes)
+{
+	QSettings settings;
+	settings.setValue(REPO_SETTINGS_IMPORT_MEMORY_BUDGET, megabytes);
+}
+
+int repo::gui::RepoImportScheduler::getMaxConcurrentImports()
+{
+	return std::max(1, QThread::idealThreadCount() / 2);
+}
+
+void repo::gui::RepoImportScheduler::workerFinished(QObject *worker)
+{
+	QMutexLocker locker(&mutex);
+	QHash<QObject*, qint64>::iterator it = running.find(worker);
+	if (running.end() != it)
+	{
+		runningBytes -= it.value();
+		running.erase(it);
+	}
+	QMetaObject::invokeMethod(this, "schedule", Qt::QueuedConnection);
+}
+
+void repo::gui::RepoImportScheduler::schedule()
+{
+	//--------------------------------------------------------------------------
+	// Drop imports whose windows were closed while waiting.
+	for (int i = queue.size() - 1; i >= 0; --i)
+	{
+		if (queue[i].window.isNull())
+		{
+			delete queue[i].worker;
+			queue.removeAt(i);
+		}
+	}
+
+	//--------------------------------------------------------------------------
+	// Admit in order while the budget allows.
+	const qint64 budget = getMemoryBudget();
+	const int maxImports = getMaxConcurrentImports();
+	QMutexLocker locker(&mutex);
+	while (!queue.isEmpty() && running.size() < maxImports &&
+		(running.isEmpty() || runningBytes + queue.first().estimatedBytes <= budget))
+	{
+		RepoQueuedImport import = queue.takeFirst();
+		std::cout << "Importing " << QFileInfo(import.filePath).fileName().toStdString();
+		std::cout << ", estimated " << RepoMemory::toMegabytes(import.estimatedBytes);
+		std::cout << " MB of " << RepoMemory::toMegabytes(budget) << " MB budget, ";
+		std::cout << queue.size() << " queued" << std::endl;
+
+		// Direct as the worker deletes itself once run() returns.
+		RepoWorkerAbstract *worker = import.worker;
+		connect(worker, &RepoWorkerAbstract::finished, this, 
+			[this, worker]() { workerFinished(worker); }, Qt::DirectConnection);
+		running.insert(import.worker, import.estimatedBytes);
+		runningBytes += import.estimatedBytes;
+		import.window->setQueuePosition(0);
+		QThreadPool::globalInstance()->start(import.worker);
+	}
+	locker.unlock();
+
+	for (int i = 0; i < queue.size(); ++i)
+		queue[i].window->setQueuePosition(i + 1);
+}
@@ -0,0 +1,134 @@
+/**
+ *  Copyright (C) 2014 3D Repo Ltd
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef REPO_IMPORT_SCHEDULER_H
+#define REPO_IMPORT_SCHEDULER_H
+
+//------------------------------------------------------------------------------
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QObject>
+#include <QPointer>
+#include <QString>
+//------------------------------------------------------------------------------
+#include "repo_worker_abstract.h"
+
+namespace repo {
+namespace gui {
+
+class RepoMdiSubWindow;
+
+/*!
+ * Queues file imports and starts only as many of them at a time as fit into
+ * the memory budget. The peak memory of each import is estimated from the
+ * file size and a per format multiplier, imports are admitted in order as
+ * long as the estimates of all running ones stay within the budget. A single
+ * import is always admitted so that files larger than the budget still load.
+ *
+ * Each import converts its meshes on several threads already, hence the
+ * number of concurrent imports is also capped at half the ideal thread count.
+ * Queued windows show their position in the queue in the progress bar.
+ */
+class RepoImportScheduler : public QObject
+{
+	Q_OBJECT
+
+public :
+
+	//! Fixed overhead of every import in bytes.
+	static const qint64 REPO_IMPORT_BASE_BYTES = 32 * 1024 * 1024;
+
+public :
+
+	//! Returns the single process-wide instance, to be used from the GUI thread.
+	static RepoImportScheduler &instance();
+
+	/*!
+	 * Queues the worker importing the given file and starts it as soon as
+	 * the budget allows. The worker is deleted without being started if the
+	 * window is closed while still queued.
+	 */
+	void enqueue(
+		RepoWorkerAbstract *worker, 
+		const QString &filePath, 
+		RepoMdiSubWindow *window);
+
+	//! Returns the estimated peak memory of importing the given file in bytes.
+	static qint64 estimatePeakBytes(const QString &filePath);
+
+	//! Returns the memory budget of concurrent imports in bytes.
+	/*!
+	 * Defaults to half of the physical memory, or 2 GB if unknown.
+	 */
+	static qint64 getMemoryBudget();
+
+	//! Stores the memory budget in MB, zero resets it to the default.
+	static void setMemoryBudget(int megabytes);
+
+	//! Returns the maximum number of concurrent imports.
+	static int getMaxConcurrentImports();
+
+private slots :
+
+	//! Starts queued imports while the budget allows, updates queue positions.
+	void schedule();
+
+private :
+
+	//! Private constructor, use instance() instead.
+	RepoImportScheduler();
+
+	/*!
+	 * Releases the budget of the finished worker. Called directly from the
+	 * worker thread while the worker still exists, schedules queued imports
+	 * in the GUI thread.
+	 */
+	void workerFinished(QObject *worker);
+
+private :
+
+	//! Import waiting for admission.
+	struct RepoQueuedImport
+	{
+		RepoWorkerAbstract *worker;
+		QString filePath;
+		qint64 estimatedBytes;
+		QPointer<RepoMdiSubWindow> window;
+	};
+
+	//! Imports waiting for admission in order.
+	QList<RepoQueuedImport> queue;
+
+	//! Guards running and runningBytes.
+	QMutex mutex;
+
+	//! Estimated bytes of running imports keyed by their workers.
+	QHash<QObject*, qint64> running;
+
+	//! Sum of the estimates of running imports.
+	qint64 runningBytes;
+
+	//! Settings memory budget label.
+	static const QString REPO_SETTINGS_IMPORT_MEMORY_BUDGET;
+
+}; // end class
+
+} // end namespace gui
+} // end namespace repo
+
+#endif // end REPO_IMPORT_SCHEDULER_H
@@ -17,10 +17,19 @@
 
 
 #include "repo_worker_assimp.h"
+#include "../conversion/repo_transcoder_graph.h"
+#include "../primitives/repo_scenecache.h"
+#include "../primitives/repo_threadpool.h"
+#include <QBuffer>
+#include <QFile>
 #include <QFileInfo>
+#include <QImageReader>
+#include <QTime>
 #include <assimp/cimport.h>
+#include <cstring>
 #include <iostream>
-#include <fstream>
+#include <set>
+#include <vector>
 //------------------------------------------------------------------------------
 
 repo::gui::RepoWorkerAssimp::RepoWorkerAssimp(
@@ -38,11 +47,12 @@ QString repo::gui::RepoWorkerAssimp::getFileName(const QString& fullFilePath)
 	return path.fileName();
 }
 
-std::map<std::string, QImage> repo::gui::RepoWorkerAssimp::loadTextures(
-        const aiScene *scene,
-        const std::string &basePath)
+std::vector<std::string> repo::gui::RepoWorkerAssimp::getTextureNames(
+	const aiScene *scene)
 {
-	std::map<std::string, QImage> namedTextures;
+	// Multiple materials can point to the same texture.
+	std::vector<std::string> fileNames;
+	std::set<std::string> uniqueFileNames;
 	for (unsigned int m = 0; m < scene->mNumMaterials; ++m)
 	{
 		int texIndex = 0;
@@ -54,115 +64,232 @@ std::map<std::string, QImage> repo::gui::RepoWorkerAssimp::loadTextures(
 		{			
 			texFound = material->GetTexture(aiTextureType_DIFFUSE, texIndex, & path);	
 			std::string fileName(path.data);
+			if (!fileName.empty() && uniqueFileNames.insert(fileName).second)
+				fileNames.push_back(fileName);
+			texIndex++;
+		}
+	}	
+	return fileNames;
+}
+
+bool repo::gui::RepoWorkerAssimp::isEmbedded(
+	const aiScene *scene, 
+	const std::string &fileName)
+{
+	// In assimp, embedded textures name starts with asterisk and a textures array index
+	// so the name can be "*0" for example
+	return scene->HasTextures() && !fileName.empty() && '*' == fileName.at(0);
+}
+
+std::map<std::string, QByteArray> repo::gui::RepoWorkerAssimp::readTextures(
+	const aiScene *scene,
+	const std::vector<std::string> &fileNames,
+	const std::string &basePath)
+{
+	std::map<std::string, QByteArray> rawTextures;
+	for (unsigned int i = 0; i < fileNames.size(); ++i)
+	{
+		if (isEmbedded(scene, fileNames[i]))
+			continue;
+		QFile file(QString::fromStdString(basePath + fileNames[i]));
+		if (file.open(QIODevice::ReadOnly))
+			rawTextures.insert(std::make_pair(fileNames[i], file.readAll()));
+	}
+	return rawTextures;
+}
+
+QStringList repo::gui::RepoWorkerAssimp::getDependencies(
+	const aiScene *scene,
+	const std::string &basePath,
+	const QString &filePath)
+{
+	QStringList dependencies;
+	const std::vector<std::string> fileNames = getTextureNames(scene);
+	for (unsigned int i = 0; i < fileNames.size(); ++i)
+		if (!isEmbedded(scene, fileNames[i]))
+			dependencies << QString::fromStdString(basePath + fileNames[i]);
+
+	// Assimp does not tell which other files it opened, material libraries
+	// are listed by the OBJ file itself.
+	QFile file(filePath);
+	if (0 == QFileInfo(filePath).suffix().compare("obj", Qt::CaseInsensitive) &&
+		file.open(QIODevice::ReadOnly))
+	{
+		while (!file.atEnd())
+		{
+			const QByteArray line = file.readLine().trimmed();
+			if (!line.startsWith("mtllib"))
+				continue;
+			const QList<QByteArray> names = line.simplified().split(' ');
+			for (int i = 1; i < names.size(); ++i)
+				dependencies << QString::fromStdString(basePath) + 
+					QString::fromUtf8(names[i]);
+		}
+	}
+	return dependencies;
+}
+
+QImage repo::gui::RepoWorkerAssimp::decodeTexture(
+	const aiScene *scene,
+	const std::string &fileName,
+	const std::string &basePath,
+	const QByteArray &data)
+{
+	QImage image;
+	if (isEmbedded(scene, fileName))
+	{ 
+		//---------------------------------------------------------------------
+		// Embedded texture
+		unsigned int textureIndex = atoi(fileName.substr(1, fileName.size()).c_str());				
+		if (textureIndex < scene->mNumTextures)
+			image = toQImage(scene->mTextures[textureIndex]);
+		else
+			std::cerr << "Embedded texture " << fileName << " does not exist." << std::endl;
+	}
+	else if (!toQImage(data, QFileInfo(QString::fromStdString(fileName)).suffix(), image))
+	{ 
+		//---------------------------------------------------------------------
+		// External texture
+		std::cerr << "Image " << basePath << fileName;
+		std::cerr << " could not be loaded." << std::endl;
+	}
+	return image;
+}
 
-			// Multiple materials can point to the same texture
-			if (!fileName.empty() && namedTextures.find(fileName.c_str()) == namedTextures.end())
+QByteArray repo::gui::RepoWorkerAssimp::getRawTexture(
+	const std::map<std::string, QByteArray> &rawTextures,
+	const std::string &fileName)
+{
+	std::map<std::string, QByteArray>::const_iterator it = rawTextures.find(fileName);
+	return rawTextures.end() != it ? it->second : QByteArray();
+}
+
+std::map<std::string, QImage> repo::gui::RepoWorkerAssimp::loadTextures(
+        const aiScene *scene,
+        const std::string &basePath,
+        std::map<std::string, QByteArray> *rawTextures)
+{
+	const std::vector<std::string> fileNames = getTextureNames(scene);
+
+	//-------------------------------------------------------------------------
+	// Decode
+	// QImage is reentrant, textures are decoded in parallel into their own 
+	// slots. The file is read only once, the very same bytes are decoded 
+	// here and later stored in the scene graph.
+	QTime time;
+	time.start();
+	std::vector<QImage> images(fileNames.size());
+	std::vector<QByteArray> files(fileNames.size());
+	RepoThreadPool::parallelFor(
+		(int) fileNames.size(),
+		[&](int i) {
+			if (!isEmbedded(scene, fileNames[i]))
 			{
-				QImage image;
-				// In assimp, embedded textures name starts with asterisk and a textures array index
-				// so the name can be "*0" for example
-				if (scene->HasTextures() && '*' == fileName.at(0))
-				{ 
-					//---------------------------------------------------------
-					// Embedded texture
-					int textureIndex = atoi(fileName.substr(1, fileName.size()).c_str());				
-					aiTexture *texture = scene->mTextures[textureIndex];
-				
-					if (0 == texture->mHeight) 
-					{
-						// if height is 0, it is compressed
-						const uchar * data = (uchar *) texture->pcData;
-						image = QImage::fromData(data, (int) texture->mWidth).
-							mirrored(false, true);								
-					}
-					else 
-					{			
-						image = QImage(
-							texture->mWidth, 
-							texture->mWidth, 
-							QImage::Format_ARGB32);
-						for (unsigned int i = 0; i < texture->mWidth; ++i) {
-							for (unsigned int j = 0; j < texture->mHeight; ++j) {
-								aiTexel texel = texture->pcData[
-									i * texture->mHeight + j];
-								image.setPixel(i, j, qRgba(
-									texel.r,
-									texel.g, 
-									texel.b, 
-									texel.a));
-							}
-						}					
-					}	
-				}
-				else
-				{ 
-					//---------------------------------------------------------
-					// External texture
-					QString fileloc((basePath + fileName).c_str());
-					if (!image.load(fileloc))
-					{			
-                        std::cerr << "Image " << fileloc.toStdString();
-                        std::cerr << " could not be loaded." << std::endl;
-						/*
-						if (fileName.size() >= 3 &&  TGAHandler::TGA_EXTENSION == fileName.substr(fileName.size() - 3, 3)) 
-						{
-							QFile file(fileloc);
-							file.open(QIODevice::ReadOnly);
-							QDataStream in(&file);    // read the data serialized from the file
-							in.setByteOrder(QDataStream::LittleEndian);
-							TGAHandler *handler = new TGAHandler();
-							handler->read(in, &image);
-						}		*/
-
-					}		
-				}
-				namedTextures.insert(std::make_pair(path.data, image));
+				QFile file(QString::fromStdString(basePath + fileNames[i]));
+				if (file.open(QIODevice::ReadOnly))
+					files[i] = file.readAll();
 			}
-			texIndex++;
+			images[i] = decodeTexture(scene, fileNames[i], basePath, files[i]);
+		},
+		RepoTranscoderAssimp::getThreadCount());
+
+	std::map<std::string, QImage> namedTextures;
+	qint64 pixelsCount = 0;
+	for (unsigned int i = 0; i < fileNames.size(); ++i)
+	{
+		pixelsCount += (qint64) images[i].width() * images[i].height();
+		namedTextures.insert(std::make_pair(fileNames[i], images[i]));
+		if (rawTextures && !images[i].isNull() && !files[i].isEmpty())
+			rawTextures->insert(std::make_pair(fileNames[i], files[i]));
+	}
+	if (!fileNames.empty())
+	{
+		std::cout << "Decoded " << fileNames.size() << " textures (";
+		std::cout << pixelsCount / 1000000.0 << " megapixels) in ";
+		std::cout << time.elapsed() << " ms" << std::endl;
+	}
+	return namedTextures;
+}
+
+bool repo::gui::RepoWorkerAssimp::toQImage(
+	const QByteArray &data, 
+	const QString &suffix,
+	QImage &image)
+{
+	// Formats such as TGA cannot be recognised from their content.
+	return !data.isEmpty() && (image.loadFromData(data) || 
+		image.loadFromData(data, suffix.toLatin1().constData()));
+}
+
+QImage repo::gui::RepoWorkerAssimp::toQImage(const aiTexture *texture)
+{
+	QImage image;
+	if (0 == texture->mHeight) 
+	{
+		// if height is 0, it is compressed
+		const uchar * data = (uchar *) texture->pcData;
+		image = QImage::fromData(data, (int) texture->mWidth).
+			mirrored(false, true);								
+	}
+	else 
+	{			
+		//---------------------------------------------------------------------
+		// Uncompressed texels are stored row by row as b, g, r, a bytes, 
+		// which is exactly the little endian memory layout of ARGB32.
+		image = QImage(
+			texture->mWidth, 
+			texture->mHeight, 
+			QImage::Format_ARGB32);
+		if (image.isNull())
+			return image;
+		for (unsigned int y = 0; y < texture->mHeight; ++y)
+		{
+			const aiTexel *row = texture->pcData + (size_t) y * texture->mWidth;
+			QRgb *scanLine = reinterpret_cast<QRgb *>(image.scanLine(y));
+			if (QSysInfo::ByteOrder == QSysInfo::LittleEndian)
+				memcpy(scanLine, row, texture->mWidth * sizeof(aiTexel));
+			else
+				for (unsigned int x = 0; x < texture->mWidth; ++x)
+					scanLine[x] = qRgba(row[x].r, row[x].g, row[x].b, row[x].a);
 		}
 	}	
-	return namedTextures;
+	return image;
 }
 
 std::map<std::string, repo::core::RepoNodeAbstract *> repo::gui::RepoWorkerAssimp::loadTextures(
-		const std::map<string, QImage> &qtextures,
-		const std::string &texturesFolderPath)
+		const std::map<std::string, QByteArray> &rawTextures)
 {
 	std::map<std::string, repo::core::RepoNodeAbstract *> repoTextures;
-	for (map<string, QImage>::const_iterator it = qtextures.begin(); it != qtextures.end(); it++)
+	std::map<std::string, QByteArray>::const_iterator it;
+	for (it = rawTextures.begin(); it != rawTextures.end(); ++it)
 	{
-		std::string name = it->first;
-		QImage qimage = it->second;
-					
-		// If QImage checked that the file exists and is loadable...
-		if (NULL != qimage.bits())
+		const std::string &name = it->first;
+		
+		// Only the header is read for the dimensions, the image itself may
+		// not have been decoded yet.
+		QBuffer buffer;
+		buffer.setData(it->second);
+		buffer.open(QIODevice::ReadOnly);
+		QSize size = QImageReader(&buffer).size();
+		if (!size.isValid())
 		{
-			// Read the raw file to save space in the DB. QImage will happily
-			// claim a file is 32 bit depth even though it is 24 for example.							
-            ifstream::pos_type size;
-            char *memblock;
-			ifstream file (texturesFolderPath + name, ios::in|ios::binary|ios::ate);
-			if (!file.is_open())
-            {
-                std::cerr <<  "Could not open texture: " << texturesFolderPath <<  name << std::endl;
-            }
-			else
-			{
-				size = file.tellg();
-				memblock = new char [size];
-				file.seekg (0, ios::beg);
-				file.read (memblock, size);
-				file.close();								
-								
-				repo::core::RepoNodeAbstract * texture = new repo::core::RepoNodeTexture(
-					name,
-					memblock,
-					(unsigned int) size,
-					qimage.width(),
-					qimage.height());
-				repoTextures.insert(std::make_pair(name, texture));	
-				delete [] memblock;
-			}
+			// Formats such as TGA cannot be recognised from their content.
+			buffer.seek(0);
+			size = QImageReader(&buffer, 
+				QFileInfo(QString::fromStdString(name)).suffix().toLatin1()).size();
+		}
+
+		// Store the raw file to save space in the DB. QImage will happily
+		// claim a file is 32 bit depth even though it is 24 for example.
+		if (size.isValid())
+		{
+			repo::core::RepoNodeAbstract * texture = new repo::core::RepoNodeTexture(
+				name,
+				it->second.constData(),
+				(unsigned int) it->second.size(),
+				size.width(),
+				size.height());
+			repoTextures.insert(std::make_pair(name, texture));	
 		}
 	}
 	return repoTextures;
@@ -175,60 +302,238 @@ void repo::gui::RepoWorkerAssimp::run()
 	int jobsCount = 5;
 	emit progress(0, 0);
 	std::string fileName = getFileName(fullPath).toStdString();
+	statistics.clear();
+	QTime totalTime;
+	totalTime.start();
+	QTime stageTime;
 
-	//-------------------------------------------------------------------------
-	// Import model
-    repo::core::AssimpWrapper assimpWrapper;
-	assimpWrapper.importModel(
-		fileName, 
-		fullPath.toStdString(), 
-		pFlags);
-    const aiScene *assimpScene = assimpWrapper.getScene();
-	emit progress(1, jobsCount);
-	
 	repo::core::RepoGraphScene * repoGraphScene = 0;
 	GLC_World glcWorld;
 
-	if (!assimpScene)
-        std::cerr << std::string(aiGetErrorString()) << std::endl;
-	else
-	{
-		//-------------------------------------------------------------------------
-		// Polygon count
-		qlonglong polyCount = 0;
-		for (unsigned int i = 0; i < assimpScene->mNumMeshes; ++i) 
-			polyCount += assimpScene->mMeshes[i]->mNumFaces;
+	//-------------------------------------------------------------------------
+	// Deferred textures
+	// If anybody is listening, the scene is shown with placeholder textures
+	// first and the decoded ones follow one by one.
+	const bool isDeferred = 
+		receivers(SIGNAL(textureLoaded(const QString &, const QImage &))) > 0;
+	std::vector<std::string> textureNames;
+	std::map<std::string, QByteArray> rawTextures;
+	std::function<QImage(const std::string &)> decodeTexture;
 
-        std::cout << "Loaded ";
-        std::cout << fileName << " with " << polyCount << " polygons in ";
-        std::cout << assimpScene->mNumMeshes << " ";
-        std::cout << ((assimpScene->mNumMeshes == 1) ? "mesh" : "meshes");
-        std::cout << std::endl;
-		emit progress(2, jobsCount);
+	//-------------------------------------------------------------------------
+	// Streamed subtrees of the world show up as early as possible, only if 
+	// anybody is listening for them.
+	std::function<void(GLC_World &)> streamChunk;
+	if (receivers(SIGNAL(chunkLoaded(GLC_World &))) > 0)
+		streamChunk = [this](GLC_World &chunk) { emit chunkLoaded(chunk); };
 
-		//-------------------------------------------------------------------------
-		// Textures
-		std::map<std::string, QImage> textures = loadTextures(
-			assimpScene,
-			assimpWrapper.getFullFolderPath());
+	//-------------------------------------------------------------------------
+	// Scene cache
+	// Unchanged files are restored from the cache without Assimp import.
+	stageTime.start();
+	RepoSceneCache sceneCache = sceneCacheDirectory.isEmpty()
+		? RepoSceneCache()
+		: RepoSceneCache(sceneCacheDirectory, -1);
+	const QString cacheKey = sceneCache.getKey(fullPath, pFlags);
+	repo::core::AssimpWrapper assimpWrapper;
+	repoGraphScene = sceneCache.load(cacheKey);
+	statistics["cacheMs"] = stageTime.elapsed();
+	statistics["cached"] = NULL != repoGraphScene;
+
+	// Reordered triangles and levels of detail of the cached entry, the ones 
+	// of a new entry are filled in while the world is built.
+	RepoMeshIndexCache indexCache(
+		RepoTranscoderAssimp::getLodErrors(), 
+		RepoTranscoderAssimp::getIndexOptimization());
+	RepoMeshIndexCache *pIndexCache = cacheKey.isEmpty() ? NULL : &indexCache;
+	if (repoGraphScene)
+	{
+		std::cout << "Loaded " << fileName << " from the scene cache" << std::endl;
 		emit progress(3, jobsCount);
+		std::map<std::string, QImage> textures;
+		if (isDeferred)
+		{
+			rawTextures = RepoTranscoderGraph::getRawTextures(repoGraphScene);
+			for (std::map<std::string, QByteArray>::const_iterator it = 
+				rawTextures.begin(); it != rawTextures.end(); ++it)
+				textureNames.push_back(it->first);
+			decodeTexture = [&](const std::string &name) {
+				QImage image;
+				toQImage(
+					getRawTexture(rawTextures, name), 
+					QFileInfo(QString::fromStdString(name)).suffix(), 
+					image);
+				return image;
+			};
+			textures = RepoTranscoderAssimp::getPlaceholderTextures(textureNames);
+		}
+		else
+			textures = RepoTranscoderGraph::getTextures(repoGraphScene);
 
-		//-------------------------------------------------------------------------
-		// Repo scene graph
-		const std::map<std::string, core::RepoNodeAbstract *> tex = loadTextures(
+		//---------------------------------------------------------------------
+		// Converted back to Assimp so that the world comes out of the same
+		// transcoder as after an import and renders the same either way.
+		stageTime.start();
+		aiScene *cachedScene = new aiScene();
+		cachedScene->mFlags = 0;
+		repoGraphScene->toAssimp(cachedScene);
+		qlonglong polyCount = 0;
+		for (unsigned int i = 0; i < cachedScene->mNumMeshes; ++i) 
+			polyCount += cachedScene->mMeshes[i]->mNumFaces;
+		statistics["meshes"] = cachedScene->mNumMeshes;
+		statistics["polygons"] = polyCount;
+		statistics["textures"] = (int) textures.size();
+		statistics["cachedIndices"] = sceneCache.loadIndices(cacheKey, indexCache);
+		glcWorld = RepoTranscoderAssimp::toGLCWorld(
+			cachedScene, 
 			textures, 
-			assimpWrapper.getFullFolderPath());
-		repoGraphScene = new repo::core::RepoGraphScene(assimpScene, tex);
-		emit progress(4, jobsCount);
+			"", 
+			streamChunk,
+			pIndexCache);
+		delete cachedScene;
+		statistics["worldMs"] = stageTime.elapsed();
 
+		// Written once more if the settings changed since.
+		if (indexCache.isModified())
+			sceneCache.storeIndices(cacheKey, indexCache);
+	}
+	else
+	{
 		//-------------------------------------------------------------------------
-		// GLC World conversion
-		glcWorld = RepoTranscoderAssimp::toGLCWorld(assimpScene, textures);
+		// Import model
+		stageTime.start();
+		assimpWrapper.importModel(
+			fileName, 
+			fullPath.toStdString(), 
+			pFlags);
+		const aiScene *assimpScene = assimpWrapper.getScene();
+		statistics["importMs"] = stageTime.elapsed();
+		emit progress(1, jobsCount);
+
+		if (!assimpScene)
+			std::cerr << std::string(aiGetErrorString()) << std::endl;
+		else
+		{
+			//-------------------------------------------------------------------------
+			// Polygon count
+			qlonglong polyCount = 0;
+			for (unsigned int i = 0; i < assimpScene->mNumMeshes; ++i) 
+				polyCount += assimpScene->mMeshes[i]->mNumFaces;
+
+			std::cout << "Loaded ";
+			std::cout << fileName << " with " << polyCount << " polygons in ";
+			std::cout << assimpScene->mNumMeshes << " ";
+			std::cout << ((assimpScene->mNumMeshes == 1) ? "mesh" : "meshes");
+			std::cout << std::endl;
+			statistics["meshes"] = assimpScene->mNumMeshes;
+			statistics["polygons"] = polyCount;
+			emit progress(2, jobsCount);
+
+			//-------------------------------------------------------------------------
+			// Textures
+			// Deferred files are only read here, decoded once the scene is shown.
+			stageTime.start();
+			const std::string basePath = assimpWrapper.getFullFolderPath();
+			std::map<std::string, QImage> textures;
+			if (isDeferred)
+			{
+				textureNames = getTextureNames(assimpScene);
+				rawTextures = readTextures(assimpScene, textureNames, basePath);
+				textures = RepoTranscoderAssimp::getPlaceholderTextures(textureNames);
+				decodeTexture = [&, assimpScene, basePath](const std::string &name) {
+					return RepoWorkerAssimp::decodeTexture(
+						assimpScene, 
+						name, 
+						basePath, 
+						getRawTexture(rawTextures, name));
+				};
+			}
+			else
+				textures = loadTextures(assimpScene, basePath, &rawTextures);
+			statistics["textures"] = (int) textures.size();
+			statistics["texturesMs"] = stageTime.elapsed();
+			emit progress(3, jobsCount);
+
+			//-------------------------------------------------------------------------
+			// GLC World and Repo scene graph
+			// Both only read the aiScene, hence they are built side by side. 
+			const QStringList dependencies = 
+				getDependencies(assimpScene, basePath, fullPath);
+			bool isStored = false;
+			QTime time;
+			time.start();
+			int worldTime = 0;
+			int sceneTime = 0;
+			RepoThreadPool::parallelFor(
+				2,
+				[&](int i) {
+					QTime taskTime;
+					taskTime.start();
+					if (0 == i)
+					{
+						glcWorld = RepoTranscoderAssimp::toGLCWorld(
+							assimpScene, 
+							textures, 
+							"", 
+							streamChunk,
+							pIndexCache);
+						worldTime = taskTime.elapsed();
+					}
+					else
+					{
+						const std::map<std::string, core::RepoNodeAbstract *> tex = 
+							loadTextures(rawTextures);
+						repoGraphScene = new repo::core::RepoGraphScene(assimpScene, tex);
+
+						// Embedded or unreadable textures are not part of the 
+						// scene graph, such scenes would not be restored 
+						// faithfully from the cache.
+						if (tex.size() == textures.size())
+							isStored = sceneCache.store(
+								cacheKey, 
+								repoGraphScene, 
+								dependencies);
+						sceneTime = taskTime.elapsed();
+					}
+				},
+				2);
+			std::cout << "GLC world (" << worldTime << " ms) and scene graph (";
+			std::cout << sceneTime << " ms) built concurrently in ";
+			std::cout << time.elapsed() << " ms" << std::endl;
+			statistics["worldMs"] = worldTime;
+			statistics["sceneMs"] = sceneTime;
+			statistics["buildMs"] = time.elapsed();
+			if (isStored)
+				sceneCache.storeIndices(cacheKey, indexCache);
+			emit progress(4, jobsCount);
+		}
 	}
+
+	// The world is shared with the GUI thread once finished is emitted.
+	if (isDeferred)
+		textureNames = RepoTranscoderAssimp::sortTexturesBySize(glcWorld, textureNames);
 	emit progress(jobsCount, jobsCount);
+	statistics["succeeded"] = NULL != repoGraphScene;
+	statistics["totalMs"] = totalTime.elapsed();
 
 	//-------------------------------------------------------------------------
 	// Done
 	emit finished(repoGraphScene, glcWorld);	
+
+	//-------------------------------------------------------------------------
+	// Decode deferred textures
+	// Decoded straight from the bytes read above, the scene graph might 
+	// already be gone.
+	if (isDeferred && decodeTexture)
+		RepoTranscoderAssimp::loadDeferredTextures(
+			textureNames,
+			[&](const std::string &name) { 
+				return cancelled ? QImage() : decodeTexture(name); 
+			},
+			[this](const QString &name, const QImage &image) {
+				if (!cancelled)
+					emit textureLoaded(name, image);
+			},
+			RepoTranscoderAssimp::getThreadCount());
 	emit RepoWorkerAbstract::finished();
 }
@@ -26,7 +26,12 @@
 #include "assimpwrapper.h"
 #include "graph/repo_graph_scene.h"
 //-----------------------------------------------------------------------------
+#include <QByteArray>
 #include <QImage>
+#include <QStringList>
+#include <QVariantMap>
+//-----------------------------------------------------------------------------
+#include <vector>
 
 namespace repo {
 namespace gui {
@@ -53,17 +58,87 @@ public :
 	//! Default empty destructor.
 	~RepoWorkerAssimp();
 
+	//! Sets the scene cache directory, empty for the default user cache.
+	/*!
+	 * An explicit directory is never evicted from, it is meant for batch
+	 * conversions rather than for a cache of recently opened files.
+	 */
+	void setSceneCacheDirectory(const QString &directory)
+	{ sceneCacheDirectory = directory; }
+
+	/*!
+	 * Returns the statistics of the last run, ie the time spent in each stage
+	 * in milliseconds and the size of the scene.
+	 */
+	QVariantMap getStatistics() const { return statistics; }
+
 	//! Returns a file name from a full file path.
 	static QString getFileName(const QString& fullPath);
 
+	//! Returns the unique diffuse texture names of all materials.
+	static std::vector<std::string> getTextureNames(const aiScene * scene);
+
+	//! Returns true if the texture name refers to an embedded texture.
+	static bool isEmbedded(const aiScene * scene, const std::string & fileName);
+
+	//! Reads the files of the external textures once, keyed by name.
+	static std::map<std::string, QByteArray> readTextures(
+		const aiScene * scene,
+		const std::vector<std::string> & fileNames,
+		const std::string & basePath);
+
+	/*!
+	 * Returns the full paths of the files the import of the given file read
+	 * besides the file itself, ie its external textures and, for Wavefront
+	 * OBJ files, material libraries.
+	 */
+	static QStringList getDependencies(
+		const aiScene * scene,
+		const std::string & basePath,
+		const QString & filePath);
+
+	//! Returns the raw bytes of the given texture, empty if not read.
+	static QByteArray getRawTexture(
+		const std::map<std::string, QByteArray> & rawTextures,
+		const std::string & fileName);
+
+	/*!
+	 * Decodes a single texture, either embedded in the scene or from the 
+	 * bytes of its file. Reentrant, call from any thread.
+	 */
+	static QImage decodeTexture(
+		const aiScene * scene,
+		const std::string & fileName,
+		const std::string & basePath,
+		const QByteArray & data);
+
 	//! Load textures stored locally at the base path.
+	/*!
+	 * Embedded as well as external textures are decoded in parallel on up 
+	 * to RepoTranscoderAssimp::getThreadCount() threads, each texture shared
+	 * by several materials only once. External files are read exactly once,
+	 * their raw bytes are returned in rawTextures if given.
+	 */
 	static std::map<std::string, QImage> loadTextures(
 		const aiScene * scene, 
-		const std::string & basePath);
+		const std::string & basePath,
+		std::map<std::string, QByteArray> *rawTextures = NULL);
 
+	/*!
+	 * Returns texture nodes of the raw texture files. Only image headers are
+	 * read for the dimensions, hence the textures need not be decoded yet.
+	 */
 	static std::map<std::string, repo::core::RepoNodeAbstract *> loadTextures(
-		const std::map<string, QImage> &qtextures,
-		const std::string &texturesFolderPath);
+		const std::map<std::string, QByteArray> &rawTextures);
+
+	//! Returns an embedded Assimp texture, compressed or not, as a QImage.
+	static QImage toQImage(const aiTexture * texture);
+
+	//! Decodes an image file from memory, suffix is the format fallback.
+	static bool toQImage(
+		const QByteArray &data, 
+		const QString &suffix,
+		QImage &image);
 
 public slots :
 
@@ -78,6 +153,20 @@ signals :
 	//! Emitted when loading is finished. Passes Repo scene and GLC world.
 	void finished(repo::core::RepoGraphScene *, GLC_World &);
 
+	/*!
+	 * Emitted during import with a preview world holding the subtrees 
+	 * converted since the previous chunk. Connect with 
+	 * Qt::BlockingQueuedConnection as the chunk is only valid during the call.
+	 */
+	void chunkLoaded(GLC_World &);
+
+	/*!
+	 * Emitted after finished() for every texture decoded in the background
+	 * if connected, the scene is then first converted with placeholders.
+	 * Emitted from the decoding threads.
+	 */
+	void textureLoaded(const QString &name, const QImage &image);
+
 private :
 
 	//! Full canonical path of the 3D file to be loaded.
@@ -85,6 +174,12 @@ private :
 
 	//! Assimp loading flags.
 	const unsigned int pFlags;
+
+	//! Scene cache directory, empty for the default user cache.
+	QString sceneCacheDirectory;
+
+	//! Stage timings and scene size of the last run.
+	QVariantMap statistics;
  
 }; // end class
 
@@ -18,14 +18,40 @@
 //------------------------------------------------------------------------------
 // GUI
 #include "repo_workerfetchrevision.h"
+#include "../conversion/repo_transcoder_graph.h"
+#include "../primitives/repo_documentcache.h"
+#include "../primitives/repo_memory.h"
+#include "../primitives/repo_threadpool.h"
 //------------------------------------------------------------------------------
 // Core
 #include <RepoNodeAbstract>
+#include <RepoNodeMaterial>
+#include <RepoNodeMesh>
 #include <RepoNodeRevision>
 #include <RepoNodeReference>
+#include <RepoNodeTexture>
+#include <RepoNodeTransformation>
 #include <RepoGraphHistory>
 #include <RepoTranscoderString>
 //------------------------------------------------------------------------------
+#include <QMutexLocker>
+#include <QPair>
+#include <QSet>
+#include <QSettings>
+#include <QTime>
+//------------------------------------------------------------------------------
+#include <GLC_3DRep>
+#include <GLC_Box>
+#include <GLC_StructInstance>
+#include <GLC_StructOccurence>
+#include <GLC_StructReference>
+//------------------------------------------------------------------------------
+#include <algorithm>
+#include <limits>
+//------------------------------------------------------------------------------
+
+const QString repo::gui::RepoWorkerFetchRevision::REPO_SETTINGS_FETCH_BATCH_SIZE =
+    "RepoWorkerFetchRevision/batchSize";
 
 repo::gui::RepoWorkerFetchRevision::RepoWorkerFetchRevision(
     const repo::core::MongoClientWrapper &mongo,
@@ -36,10 +62,18 @@ repo::gui::RepoWorkerFetchRevision::RepoWorkerFetchRevision(
 	, database(database.toStdString())
 	, id(id)
 	, headRevision(headRevision)
+	, hasViewpoint(false)
 {}
 
 repo::gui::RepoWorkerFetchRevision::~RepoWorkerFetchRevision() {}
 
+void repo::gui::RepoWorkerFetchRevision::setCamera(const GLC_Camera &camera)
+{
+	QMutexLocker locker(&viewpointMutex);
+	viewpoint = camera.eye();
+	hasViewpoint = true;
+}
+
 void repo::gui::RepoWorkerFetchRevision::run()
 {
 	//-------------------------------------------------------------------------
@@ -51,47 +85,64 @@ void repo::gui::RepoWorkerFetchRevision::run()
 
 	GLC_World glcWorld;
     core::RepoGraphScene *masterSceneGraph = NULL;
+
+    //--------------------------------------------------------------------------
+    // Deferred textures
+    // If anybody is listening, the revision is shown with placeholder
+    // textures first and the decoded ones follow one by one.
+    const bool isDeferred =
+        receivers(SIGNAL(textureLoaded(const QString &, const QImage &))) > 0;
+    std::vector<std::string> textureNames;
+    std::map<std::string, QByteArray> rawTextures;
 	if (!cancelled && !mongo.reconnect())
     {
         std::cerr << "Connection failed" << std::endl;
     }
 	else
 	{
-         masterSceneGraph = fetchSceneRecursively(
+         masterSceneGraph = fetchFederation(
             database,
             id.toString().toStdString(),
-            headRevision,
-            NULL,
-            NULL);
+            headRevision);
 
-        //----------------------------------------------------------------------
-		// Convert to Assimp
-		// TODO: code in direct conversion from RepoSceneGraph to GLC_World
-		// to avoid intermediary Assimp aiScene conversion!
-		aiScene* scene = new aiScene();
         if (!cancelled && masterSceneGraph)
 		{
-            masterSceneGraph->toAssimp(scene);
-			emit progress(done++, jobsCount);
-
             //------------------------------------------------------------------
             // Convert raw textures into QImages
+            // Deferred ones are copied as the scene graph is handed over
+            // before they are decoded.
             std::map<std::string, QImage> namedTextures;
-            std::vector<repo::core::RepoNodeTexture*> textures =
-                    masterSceneGraph->getTextures();
-            for (unsigned int i = 0; !cancelled && i < textures.size(); ++i)
+            if (isDeferred)
             {
-                repo::core::RepoNodeTexture* repoTex = textures[i];
-                const unsigned char* data = (unsigned char*) repoTex->getData();
-                QImage image = QImage::fromData(data, repoTex->getDataSize());
-                namedTextures.insert(std::make_pair(repoTex->getName(), image));
+                rawTextures = RepoTranscoderGraph::getRawTextures(masterSceneGraph);
+                for (std::map<std::string, QByteArray>::const_iterator it =
+                    rawTextures.begin(); it != rawTextures.end(); ++it)
+                    textureNames.push_back(it->first);
+                namedTextures =
+                    RepoTranscoderAssimp::getPlaceholderTextures(textureNames);
             }
+            else
+                namedTextures =
+                    repo::gui::RepoTranscoderGraph::getTextures(masterSceneGraph);
             emit progress(done++, jobsCount);
 
             //------------------------------------------------------------------
             // GLC World conversion
+            // Straight from the scene graph, without an intermediary aiScene.
             if (!cancelled)
-                glcWorld = repo::gui::RepoTranscoderAssimp::toGLCWorld(scene, namedTextures);
+            {
+                if (RepoTranscoderGraph::getBenchmark())
+                    RepoTranscoderGraph::benchmark(masterSceneGraph, namedTextures);
+                glcWorld = repo::gui::RepoTranscoderGraph::toGLCWorld(
+                    masterSceneGraph, namedTextures);
+
+                // The world is shared with the GUI thread once finished is
+                // emitted.
+                if (isDeferred)
+                    textureNames = RepoTranscoderAssimp::sortTexturesBySize(
+                        glcWorld, textureNames);
+            }
+            emit progress(done++, jobsCount);
         }
 	}
 
@@ -99,26 +150,414 @@ void repo::gui::RepoWorkerFetchRevision::run()
 	emit progress(jobsCount, jobsCount);
     //--------------------------------------------------------------------------
     emit finished(masterSceneGraph, glcWorld);
+
+    //--------------------------------------------------------------------------
+    // Decode deferred textures
+    if (isDeferred && !cancelled)
+        RepoTranscoderAssimp::loadDeferredTextures(
+            textureNames,
+            [&](const std::string &name) {
+                return cancelled ? QImage() : QImage::fromData(rawTextures.at(name));
+            },
+            [this](const QString &name, const QImage &image) {
+                if (!cancelled)
+                    emit textureLoaded(name, image);
+            },
+            RepoTranscoderAssimp::getThreadCount());
 	emit RepoWorkerAbstract::finished();
 }
 
-repo::core::RepoGraphScene * repo::gui::RepoWorkerFetchRevision::fetchSceneRecursively(
+repo::core::RepoGraphScene * repo::gui::RepoWorkerFetchRevision::fetchFederation(
+        const std::string &database,
+        const std::string &uuid,
+        bool isHeadRevision)
+{
+    // Geometry of the root revision streams in only if anybody is listening.
+    core::RepoGraphScene *masterSceneGraph =
+        receivers(SIGNAL(chunkLoaded(GLC_World &))) > 0
+        ? fetchSceneInTwoPhases(mongo, database, uuid, isHeadRevision)
+        : fetchScene(mongo, database, uuid, isHeadRevision, true);
+    if (!masterSceneGraph)
+        return NULL;
+    std::vector<core::RepoNodeAbstract *> references =
+        masterSceneGraph->getReferences();
+
+    //--------------------------------------------------------------------------
+    //
+    // FEDERATION
+    //
+    //--------------------------------------------------------------------------
+    // Each level of references is fetched in parallel, every thread over its
+    // own connection taken from the pool.
+    std::vector<core::MongoClientWrapper> connections;
+    std::vector<int> freeConnections;
+    QMutex connectionsMutex;
+    while (!cancelled && !references.empty())
+    {
+        QTime time;
+        time.start();
+        const int threadsCount = std::min(
+            (int) references.size(), (int) REPO_FETCH_CONNECTIONS_COUNT);
+        while ((int) connections.size() < threadsCount)
+        {
+            connections.push_back(mongo);
+            if (!connections.back().reconnect())
+                std::cerr << "Connection failed" << std::endl;
+            freeConnections.push_back((int) connections.size() - 1);
+        }
+        {
+            QMutexLocker locker(&progressMutex);
+            jobsCount += (int) references.size();
+        }
+
+        std::vector<core::RepoGraphScene *> children(references.size(), NULL);
+        RepoThreadPool::parallelFor(
+            (int) references.size(),
+            [&](int i) {
+                core::RepoNodeReference *reference =
+                    (core::RepoNodeReference *) references[i];
+                // TODO: modify mongowrapper to take into account reference owner and project!
+                connectionsMutex.lock();
+                const int c = freeConnections.back();
+                freeConnections.pop_back();
+                connectionsMutex.unlock();
+
+                if (!cancelled)
+                    children[i] = fetchScene(
+                        connections[c],
+                        reference->getProject(),
+                        core::RepoTranscoderString::toString(reference->getRevisionID()),
+                        !reference->getIsUniqueID(),
+                        false);
+
+                connectionsMutex.lock();
+                freeConnections.push_back(c);
+                connectionsMutex.unlock();
+
+                QMutexLocker locker(&progressMutex);
+                emit progress(done++, jobsCount);
+            },
+            threadsCount);
+        std::cout << "Fetched " << references.size() << " referenced revisions in ";
+        std::cout << time.elapsed() << " ms" << std::endl;
+
+        //----------------------------------------------------------------------
+        // Append in the order of the references, collect the next level.
+        std::vector<core::RepoNodeAbstract *> nextReferences;
+        for (unsigned int i = 0; i < children.size(); ++i)
+        {
+            if (!children[i])
+                continue;
+            const std::vector<core::RepoNodeAbstract *> childReferences =
+                children[i]->getReferences();
+            nextReferences.insert(nextReferences.end(),
+                childReferences.begin(), childReferences.end());
+
+            // Append child scene graph to the master graph, this
+            // clears the childSceneGraph blank
+            masterSceneGraph->append(
+                (core::RepoNodeReference *) references[i], children[i]);
+
+            // Delete the remaining empty graph.
+            delete children[i];
+        }
+        references = nextReferences;
+    }
+    return masterSceneGraph;
+}
+
+repo::core::RepoGraphScene * repo::gui::RepoWorkerFetchRevision::fetchScene(
+        core::MongoClientWrapper &connection,
         const std::string &database,
         const std::string &uuid,
         bool isHeadRevision,
-        core::RepoGraphScene *masterSceneGraph,
-        core::RepoNodeReference *referenceNode)
+        bool reportDocuments)
 {
     std::cout << "Fetching: " << database << " " << uuid << std::endl;
-    jobsCount += 4;
+    if (reportDocuments)
+        jobsCount += 4;
 
-    mongo.reauthenticate(database);
     //--------------------------------------------------------------------------
     // Fetch data from DB
+    const qint64 peakMemoryBefore = RepoMemory::getPeakResidentBytes();
+    QTime time;
+    time.start();
     std::vector<mongo::BSONObj> data;
-    // TODO: fetch transformations first to build the scene
-    // and reconstruct meshes later so as to give visual feedback to the user immediatelly
-    // (eg as meshes popping up in XML3DRepo)
+    mongo::BSONArray array =
+        fetchRevisionIDs(connection, database, uuid, isHeadRevision);
+    //----------------------------------------------------------------------
+    if (reportDocuments)
+        emit progress(done++, jobsCount);
+    //----------------------------------------------------------------------
+    fetchDocuments(
+        connection,
+        database,
+        array,
+        mongo::BSONObj(),
+        reportDocuments,
+        data);
+    if (reportDocuments)
+        emit progress(done++, jobsCount);
+
+    //----------------------------------------------------------------------
+    // Convert to Repo scene graph
+    core::RepoGraphScene *sceneGraph = NULL;
+    if (!cancelled)
+    {
+        sceneGraph = new core::RepoGraphScene(data);
+        std::cout << "Found " << sceneGraph->getReferences().size();
+        std::cout << " references" << std::endl;
+        std::cout << "Fetched and decoded in " << time.elapsed() << " ms, peak ";
+        std::cout << "resident memory " << RepoMemory::toMegabytes(peakMemoryBefore);
+        std::cout << " MB before and "
+            << RepoMemory::toMegabytes(RepoMemory::getPeakResidentBytes());
+        std::cout << " MB after" << std::endl;
+        if (reportDocuments)
+            emit progress(done++, jobsCount);
+    }
+    return sceneGraph;
+}
+
+repo::core::RepoGraphScene * repo::gui::RepoWorkerFetchRevision::fetchSceneInTwoPhases(
+        core::MongoClientWrapper &connection,
+        const std::string &database,
+        const std::string &uuid,
+        bool isHeadRevision)
+{
+    std::cout << "Fetching in two phases: " << database << " " << uuid << std::endl;
+    jobsCount += 4;
+    QTime time;
+    time.start();
+
+    //--------------------------------------------------------------------------
+    //
+    // PHASE 1: Skeleton
+    //
+    //--------------------------------------------------------------------------
+    // All documents without the geometry, which is most of the payload.
+    const mongo::BSONArray array =
+        fetchRevisionIDs(connection, database, uuid, isHeadRevision);
+    emit progress(done++, jobsCount);
+    std::vector<mongo::BSONObj> data;
+    fetchDocuments(
+        connection,
+        database,
+        array,
+        BSON(REPO_NODE_LABEL_VERTICES << 0 <<
+            REPO_NODE_LABEL_FACES << 0 <<
+            REPO_NODE_LABEL_NORMALS << 0 <<
+            REPO_NODE_LABEL_COLORS << 0 <<
+            REPO_NODE_LABEL_UV_CHANNELS << 0),
+        true,
+        data);
+    if (cancelled)
+        return NULL;
+
+    core::RepoGraphScene *skeleton = new core::RepoGraphScene(data);
+    QHash<const core::RepoNodeAbstract*, QList<GLC_Matrix4x4> > instances;
+    if (skeleton->getRoot())
+        getMeshInstances(skeleton->getRoot(), GLC_Matrix4x4(), instances);
+    QHash<QByteArray, const core::RepoNodeAbstract*> meshes;
+    const std::vector<core::RepoNodeAbstract *> skeletonMeshes = skeleton->getMeshes();
+    for (unsigned int i = 0; i < skeletonMeshes.size(); ++i)
+    {
+        const boost::uuids::uuid id = skeletonMeshes[i]->getUniqueID();
+        meshes.insert(QByteArray((const char *) id.data, (int) id.size()), skeletonMeshes[i]);
+    }
+
+    //--------------------------------------------------------------------------
+    // Translucent box of every mesh instance, the world space centre of the
+    // first instance of each mesh is its distance to the camera. Meshes that
+    // are not instanced under transformations have no box but are fetched
+    // all the same, last, so that the final scene graph is complete.
+    QHash<QByteArray, int> indices;
+    QHash<QByteArray, GLC_Point3d> centres;
+    GLC_Point3d sceneCentre;
+    GLC_World boxes;
+    GLC_Material *boxMaterial = new GLC_Material(Qt::gray);
+    boxMaterial->setOpacity(0.1);
+    for (unsigned int i = 0; i < data.size(); ++i)
+    {
+        const QByteArray id = getID(data[i]);
+        const core::RepoNodeAbstract *mesh = meshes.value(id, NULL);
+        if (!mesh)
+            continue;
+        indices.insert(id, i);
+        if (!instances.contains(mesh))
+            continue;
+
+        std::vector<mongo::BSONElement> bounds;
+        if (data[i].hasField(REPO_NODE_LABEL_BOUNDING_BOX))
+            bounds = data[i].getField(REPO_NODE_LABEL_BOUNDING_BOX).Array();
+        GLC_Point3d min, max;
+        if (2 == bounds.size())
+        {
+            const std::vector<mongo::BSONElement> a = bounds[0].Array();
+            const std::vector<mongo::BSONElement> b = bounds[1].Array();
+            if (3 == a.size() && 3 == b.size())
+            {
+                min.setVect(a[0].numberDouble(), a[1].numberDouble(), a[2].numberDouble());
+                max.setVect(b[0].numberDouble(), b[1].numberDouble(), b[2].numberDouble());
+            }
+        }
+        const GLC_Point3d centre = (min + max) * 0.5;
+        const GLC_Vector3d lengths = max - min;
+        const QList<GLC_Matrix4x4> &matrices = instances[mesh];
+        centres.insert(id, matrices.first() * centre);
+        sceneCentre = sceneCentre + matrices.first() * centre;
+
+        GLC_Box *box = new GLC_Box(lengths.x(), lengths.y(), lengths.z());
+        box->replaceMasterMaterial(boxMaterial);
+        GLC_StructReference *reference = new GLC_StructReference(new GLC_3DRep(box));
+        for (int j = 0; j < matrices.size(); ++j)
+        {
+            GLC_StructInstance *instance = new GLC_StructInstance(reference);
+            instance->move(matrices[j] * GLC_Matrix4x4(centre));
+            boxes.rootOccurence()->addChild(new GLC_StructOccurence(instance));
+        }
+    }
+    if (!centres.isEmpty())
+        sceneCentre = sceneCentre * (1.0 / centres.size());
+    if (boxMaterial->isUnused())
+        delete boxMaterial;
+    boxes.rootOccurence()->updateChildrenAbsoluteMatrix();
+    emit chunkLoaded(boxes);
+    emit progress(done++, jobsCount);
+    std::cout << "Skeleton of " << data.size() << " documents with ";
+    std::cout << indices.size() << " meshes fetched in " << time.elapsed();
+    std::cout << " ms" << std::endl;
+
+    //--------------------------------------------------------------------------
+    //
+    // PHASE 2: Geometry
+    //
+    //--------------------------------------------------------------------------
+    // Chunks reuse the materials of the skeleton with placeholder textures,
+    // the decoded ones come with the complete world.
+    std::vector<std::string> textureNames;
+    const std::vector<core::RepoNodeTexture *> textures = skeleton->getTextures();
+    for (unsigned int i = 0; i < textures.size(); ++i)
+        textureNames.push_back(textures[i]->getName());
+    const QHash<QString, GLC_Texture> glcTextures =
+        RepoTranscoderAssimp::toGLCTextures(
+            RepoTranscoderAssimp::getPlaceholderTextures(textureNames), 1);
+
+    QList<QByteArray> pending = indices.keys();
+    jobsCount += (pending.size() + REPO_FETCH_MESHES_BATCH_SIZE - 1) /
+        REPO_FETCH_MESHES_BATCH_SIZE;
+    while (!cancelled && !pending.isEmpty())
+    {
+        //----------------------------------------------------------------------
+        // Nearest to the camera first, re-sorted for every batch as the user
+        // might have moved it in the meantime.
+        GLC_Point3d eye = sceneCentre;
+        {
+            QMutexLocker locker(&viewpointMutex);
+            if (hasViewpoint)
+                eye = viewpoint;
+        }
+        QList<QPair<double, QByteArray> > sorted;
+        for (int i = 0; i < pending.size(); ++i)
+            sorted << qMakePair(centres.contains(pending[i]) 
+                ? (centres.value(pending[i]) - eye).length()
+                : std::numeric_limits<double>::max(), pending[i]);
+        std::sort(sorted.begin(), sorted.end());
+
+        const int batchSize = std::min(REPO_FETCH_MESHES_BATCH_SIZE, sorted.size());
+        mongo::BSONArrayBuilder ids;
+        pending.clear();
+        for (int i = 0; i < sorted.size(); ++i)
+        {
+            if (i < batchSize)
+                ids.append(data[indices.value(sorted[i].second)].getField(REPO_NODE_LABEL_ID));
+            else
+                pending << sorted[i].second;
+        }
+        std::vector<mongo::BSONObj> batch;
+        fetchDocuments(connection, database, ids.arr(), mongo::BSONObj(), false, batch);
+
+        //----------------------------------------------------------------------
+        // Convert the batch and place every instance of it in the world.
+        GLC_World chunk;
+        QHash<const core::RepoNodeAbstract*, int> materialIndices;
+        QVector<GLC_Material*> glcMaterials;
+        QVector<const core::RepoNodeAbstract*> batchMeshes(batch.size(), NULL);
+        for (unsigned int i = 0; i < batch.size(); ++i)
+        {
+            const QByteArray id = getID(batch[i]);
+            if (!indices.contains(id))
+                continue;
+            data[indices.value(id)] = batch[i];
+            batchMeshes[i] = meshes.value(id);
+            const core::RepoNodeAbstract *material = RepoTranscoderGraph::getChild(
+                batchMeshes[i], REPO_NODE_TYPE_MATERIAL);
+            if (material && !materialIndices.contains(material))
+            {
+                materialIndices.insert(material, glcMaterials.size());
+                glcMaterials << RepoTranscoderGraph::toGLCMaterial(
+                    static_cast<const core::RepoNodeMaterial*>(material), glcTextures);
+            }
+        }
+        glcMaterials << NULL;
+        QHash<QString, GLC_Material*> glcMaterialsPool =
+            RepoTranscoderAssimp::poolMaterials(glcMaterials);
+
+        QVector<GLC_3DRep*> glcMeshes(batch.size(), NULL);
+        for (unsigned int i = 0; i < batch.size(); ++i)
+        {
+            if (!batchMeshes[i] || !instances.contains(batchMeshes[i]))
+                continue;
+            const core::RepoNodeMesh mesh(batch[i]);
+            const core::RepoNodeAbstract *material = RepoTranscoderGraph::getChild(
+                batchMeshes[i], REPO_NODE_TYPE_MATERIAL);
+            glcMeshes[i] = RepoTranscoderGraph::toGLCMesh(
+                &mesh,
+                material ? materialIndices.value(material) : glcMaterials.size() - 1,
+                glcMaterials,
+                "");
+            if (!glcMeshes[i] || glcMeshes[i]->isEmpty())
+                continue;
+            GLC_StructReference *reference =
+                new GLC_StructReference(new GLC_3DRep(*glcMeshes[i]));
+            const QList<GLC_Matrix4x4> &matrices = instances[batchMeshes[i]];
+            for (int j = 0; j < matrices.size(); ++j)
+            {
+                GLC_StructInstance *instance = new GLC_StructInstance(reference);
+                instance->move(matrices[j]);
+                chunk.rootOccurence()->addChild(new GLC_StructOccurence(instance));
+            }
+        }
+        chunk.rootOccurence()->updateChildrenAbsoluteMatrix();
+        RepoTranscoderAssimp::deleteUnusedMaterials(glcMaterialsPool);
+        for (int i = 0; i < glcMeshes.size(); ++i)
+            delete glcMeshes[i];
+
+        if (!cancelled)
+            emit chunkLoaded(chunk);
+        emit progress(done++, jobsCount);
+    }
+    delete skeleton;
+    std::cout << "Geometry of " << indices.size() << " meshes streamed in ";
+    std::cout << time.elapsed() << " ms" << std::endl;
+
+    //--------------------------------------------------------------------------
+    // Complete scene graph out of the skeleton with the geometry filled in.
+    core::RepoGraphScene *sceneGraph = NULL;
+    if (!cancelled)
+    {
+        sceneGraph = new core::RepoGraphScene(data);
+        emit progress(done++, jobsCount);
+    }
+    return sceneGraph;
+}
+
+mongo::BSONArray repo::gui::RepoWorkerFetchRevision::fetchRevisionIDs(
+        core::MongoClientWrapper &connection,
+        const std::string &database,
+        const std::string &uuid,
+        bool isHeadRevision)
+{
+    connection.reauthenticate(database);
 
     //--------------------------------------------------------------------------
     // First load revision object
@@ -131,106 +570,293 @@ repo::core::RepoGraphScene * repo::gui::RepoWorkerFetchRevision::fetchSceneRecur
     // TODO: make this adhere to the revision history graph so that it does not
     // rely on timestamps!
     mongo::BSONObj bson = isHeadRevision
-        ? mongo.findOneBySharedID(
+        ? connection.findOneBySharedID(
             database,
             REPO_COLLECTION_HISTORY,
             uuid,
             REPO_NODE_LABEL_TIMESTAMP,
             fieldsToReturn)
-        : mongo.findOneByUniqueID(
+        : connection.findOneByUniqueID(
             database,
             REPO_COLLECTION_HISTORY,
             uuid,
             fieldsToReturn);
 
    // std::cout << bson.toString(false, true) << std::endl;
-    mongo::BSONArray array = mongo::BSONArray(bson.getObjectField(REPO_NODE_LABEL_CURRENT_UNIQUE_IDS));
-    //----------------------------------------------------------------------
-    emit progress(done++, jobsCount);
-    //----------------------------------------------------------------------
+    return mongo::BSONArray(bson.getObjectField(REPO_NODE_LABEL_CURRENT_UNIQUE_IDS));
+}
+
+void repo::gui::RepoWorkerFetchRevision::fetchDocuments(
+        core::MongoClientWrapper &connection,
+        const std::string &database,
+        const mongo::BSONArray &array,
+        const mongo::BSONObj &projection,
+        bool reportDocuments,
+        std::vector<mongo::BSONObj> &data)
+{
+    fetchDocuments(
+        connection,
+        database,
+        array,
+        projection,
+        reportDocuments,
+        [&](const mongo::BSONObj &obj) { data.push_back(obj); });
+}
+
+void repo::gui::RepoWorkerFetchRevision::fetchDocuments(
+        core::MongoClientWrapper &connection,
+        const std::string &database,
+        const mongo::BSONArray &array,
+        const mongo::BSONObj &projection,
+        bool reportDocuments,
+        const std::function<void(const mongo::BSONObj &)> &consume)
+{
     int fieldsCount = array.nFields();
     if (!cancelled && fieldsCount > 0)
     {
-        jobsCount += fieldsCount;
-        unsigned long long retrieved = 0;
-        std::auto_ptr<mongo::DBClientCursor> cursor;
-        do
+        //----------------------------------------------------------------------
+        // Scene documents never change, cached ones are not fetched again.
+        // Cached documents are complete, hence good for any projection.
+        RepoDocumentCache documentCache;
+        qint64 cachedBytes = 0;
+        int hitsCount = 0;
+        const mongo::BSONArray missing = documentCache.load(
+            database,
+            array,
+            [&](const mongo::BSONObj &obj) { ++hitsCount; consume(obj); },
+            &cachedBytes);
+        std::cout << "Document cache: " << hitsCount << " of " << fieldsCount;
+        std::cout << " hits (" << 100.0 * hitsCount / fieldsCount << "%), ";
+        std::cout << RepoMemory::toMegabytes(cachedBytes) << " MB saved" << std::endl;
+        if (reportDocuments)
+        {
+            jobsCount += fieldsCount;
+            done += hitsCount;
+            emit progress(done, jobsCount);
+        }
+
+        // Fetched documents are stored in small batches as they arrive.
+        std::vector<mongo::BSONObj> fetched;
+        if (hitsCount < fieldsCount)
         {
-            for (; !cancelled && cursor.get() && cursor->more(); ++retrieved)
+            //------------------------------------------------------------------
+            // The IDs are queried in bounded batches, several of them in
+            // flight at once, each over its own connection. Documents are
+            // passed on one at a time whichever batch they come from.
+            const std::vector<mongo::BSONArray> batches =
+                splitIDs(missing, getBatchSize());
+            const int threadsCount = std::min(
+                (int) batches.size(), (int) REPO_FETCH_BATCHES_IN_FLIGHT);
+            std::vector<core::MongoClientWrapper> copies;
+            copies.reserve(threadsCount);
+            std::vector<core::MongoClientWrapper *> freeConnections(1, &connection);
+            while ((int) freeConnections.size() < threadsCount)
             {
-                data.push_back(cursor->nextSafe().copy());
-                emit progress(done++, jobsCount);
+                copies.push_back(connection);
+                if (!copies.back().reconnect())
+                    std::cerr << "Connection failed" << std::endl;
+                copies.back().reauthenticate(database);
+                freeConnections.push_back(&copies.back());
+            }
+            QMutex connectionsMutex;
+            QMutex consumeMutex;
+            int missingCount = 0;
+
+            QTime time;
+            time.start();
+            RepoThreadPool::parallelFor(
+                (int) batches.size(),
+                [&](int i) {
+                    connectionsMutex.lock();
+                    core::MongoClientWrapper *batchConnection = freeConnections.back();
+                    freeConnections.pop_back();
+                    connectionsMutex.unlock();
+
+                    const int batchMissingCount = fetchBatch(
+                        *batchConnection,
+                        database,
+                        batches[i],
+                        projection,
+                        [&](const mongo::BSONObj &obj) {
+                            QMutexLocker locker(&consumeMutex);
+                            consume(obj);
+                            if (projection.isEmpty())
+                            {
+                                fetched.push_back(obj);
+                                if (fetched.size() >= REPO_DOCUMENT_CACHE_BATCH_SIZE)
+                                {
+                                    documentCache.store(database, fetched);
+                                    fetched.clear();
+                                }
+                            }
+                            if (reportDocuments)
+                            {
+                                QMutexLocker progressLocker(&progressMutex);
+                                emit progress(done++, jobsCount);
+                            }
+                        });
+
+                    connectionsMutex.lock();
+                    freeConnections.push_back(batchConnection);
+                    missingCount += batchMissingCount;
+                    connectionsMutex.unlock();
+                },
+                threadsCount);
+            std::cout << "Fetched " << missing.nFields() << " documents in ";
+            std::cout << batches.size() << " batches over " << threadsCount;
+            std::cout << " connections in " << time.elapsed() << " ms" << std::endl;
+            if (!cancelled && missingCount > 0)
+            {
+                const QString message = QString::number(missingCount) + 
+                    " of " + QString::number(missing.nFields()) + 
+                    " documents of " + QString::fromStdString(database) + 
+                    " could not be fetched";
+                std::cerr << message.toStdString() << std::endl;
+                emit error(message);
             }
-            if (!cancelled)
-                cursor = mongo.findAllByUniqueIDs(
-                    database,
-                    REPO_COLLECTION_SCENE,
-                    array,
-                    retrieved);
         }
-        while (!cancelled && cursor.get() && cursor->more());
+        if (!fetched.empty())
+            documentCache.store(database, fetched);
     }
     else
     {
         std::cerr << "Deprecated DB retrieval" << std::endl;
-        mongo.fetchEntireCollection(database, REPO_COLLECTION_SCENE, data);
+        std::vector<mongo::BSONObj> data;
+        connection.fetchEntireCollection(database, REPO_COLLECTION_SCENE, data);
+        for (unsigned int i = 0; i < data.size(); ++i)
+            consume(data[i]);
     }
-    //----------------------------------------------------------------------
+}
 
-    emit progress(done++, jobsCount);
+void repo::gui::RepoWorkerFetchRevision::getMeshInstances(
+        const core::RepoNodeAbstract *node,
+        const GLC_Matrix4x4 &parentMatrix,
+        QHash<const core::RepoNodeAbstract*, QList<GLC_Matrix4x4> > &instances)
+{
+    GLC_Matrix4x4 matrix = parentMatrix;
+    if (REPO_NODE_TYPE_TRANSFORMATION == node->getType())
+        matrix = parentMatrix * RepoTranscoderAssimp::toGLCMatrix(
+            static_cast<const core::RepoNodeTransformation*>(node)->getMatrix());
 
-    //----------------------------------------------------------------------
-    // Convert to Repo scene graph
-    std::vector<core::RepoNodeAbstract *> references;
-    if (!cancelled)
+    const std::set<const core::RepoNodeAbstract*> children = node->getChildren();
+    for (std::set<const core::RepoNodeAbstract*>::const_iterator it =
+        children.begin(); it != children.end(); ++it)
     {
-        core::RepoGraphScene *childSceneGraph = new core::RepoGraphScene(data);
-        emit progress(done++, jobsCount);
+        const std::string type = (*it)->getType();
+        if (REPO_NODE_TYPE_MESH == type)
+            instances[*it] << matrix;
+        else if (REPO_NODE_TYPE_TRANSFORMATION == type)
+            getMeshInstances(*it, matrix, instances);
+    }
+}
 
-        //----------------------------------------------------------------------
-        if (childSceneGraph)
+int repo::gui::RepoWorkerFetchRevision::fetchBatch(
+        core::MongoClientWrapper &connection,
+        const std::string &database,
+        const mongo::BSONArray &ids,
+        const mongo::BSONObj &projection,
+        const std::function<void(const mongo::BSONObj &)> &consume)
+{
+    // A cursor that ends early is resumed by asking again for only the IDs
+    // of this batch which have not arrived yet, rather than skipping over
+    // the ones that did. Gives up once a query brings nothing new.
+    QSet<QByteArray> received;
+    mongo::BSONArray remaining = ids;
+    while (!cancelled && remaining.nFields() > 0)
+    {
+        std::auto_ptr<mongo::DBClientCursor> cursor =
+            findByUniqueIDs(connection, database, remaining, projection);
+        int retrieved = 0;
+        for (; !cancelled && cursor.get() && cursor->more(); ++retrieved)
         {
-            references = childSceneGraph->getReferences();
-            if (masterSceneGraph == NULL)
-                masterSceneGraph = childSceneGraph;
-            else
-            {
-                // Append child scene graph to the master graph, this
-                // clears the childSceneGraph blank
-                masterSceneGraph->append(referenceNode, childSceneGraph);
+            const mongo::BSONObj obj = cursor->nextSafe().copy();
+            received.insert(getID(obj));
+            consume(obj);
+        }
+        if (retrieved >= remaining.nFields())
+            return 0;
+        if (0 == retrieved)
+        {
+            if (!cancelled)
+                std::cerr << "Cursor brought nothing, giving up on "
+                    << remaining.nFields() << " documents" << std::endl;
+            break;
+        }
 
-                // Delete the remaining empty graph.
-                delete childSceneGraph;
-            }
-            jobsCount += references.size();
-            std::cout << "Found " << references.size() << " references" << std::endl;
+        mongo::BSONArrayBuilder builder;
+        mongo::BSONObjIterator it(remaining);
+        while (it.more())
+        {
+            const mongo::BSONElement element = it.next();
+            int length = 0;
+            const char *bytes = element.binData(length);
+            if (!received.contains(QByteArray(bytes, length)))
+                builder.append(element);
         }
-        emit progress(done++, jobsCount);
+        remaining = builder.arr();
+        std::cerr << "Cursor ended early, resuming batch with ";
+        std::cerr << remaining.nFields() << " documents left" << std::endl;
     }
+    return cancelled ? 0 : remaining.nFields();
+}
 
+std::auto_ptr<mongo::DBClientCursor> repo::gui::RepoWorkerFetchRevision::findByUniqueIDs(
+        core::MongoClientWrapper &connection,
+        const std::string &database,
+        const mongo::BSONArray &ids,
+        const mongo::BSONObj &projection)
+{
+    if (projection.isEmpty())
+        return connection.findAllByUniqueIDs(
+            database,
+            REPO_COLLECTION_SCENE,
+            ids,
+            0);
 
-    //--------------------------------------------------------------------------
-    //
-    // FEDERATION
-    //
-    //--------------------------------------------------------------------------
-    // Fetch references if any
-    for (unsigned int i = 0; !cancelled && i < references.size(); ++i)
-    {
-        core::RepoNodeReference *reference = (core::RepoNodeReference *) references[i];
-        // TODO: modify mongowrapper to take into account reference owner and project!
-
-        // Recursion
-        std::string refUuuid = core::RepoTranscoderString::toString(reference->getRevisionID());
-        fetchSceneRecursively(
-                    reference->getProject(),
-                    refUuuid,
-                    !reference->getIsUniqueID(),
-                    masterSceneGraph,
-                    reference);
+    // The wrapper has no projection of its own, the driver query takes the
+    // fields to return directly.
+    return connection.clientConnection.query(
+        database + "." + REPO_COLLECTION_SCENE,
+        QUERY(REPO_NODE_LABEL_ID << BSON("$in" << ids)),
+        0,
+        0,
+        &projection);
+}
 
-        emit progress(done++, jobsCount);
+std::vector<mongo::BSONArray> repo::gui::RepoWorkerFetchRevision::splitIDs(
+        const mongo::BSONArray &ids,
+        int batchSize)
+{
+    std::vector<mongo::BSONArray> batches;
+    mongo::BSONObjIterator it(ids);
+    while (it.more())
+    {
+        mongo::BSONArrayBuilder builder;
+        for (int count = 0; count < batchSize && it.more(); ++count)
+            builder.append(it.next());
+        batches.push_back(builder.arr());
     }
+    return batches;
+}
 
-    return masterSceneGraph;
+int repo::gui::RepoWorkerFetchRevision::getBatchSize()
+{
+    QSettings settings;
+    return std::max(1, settings.value(
+        REPO_SETTINGS_FETCH_BATCH_SIZE,
+        REPO_FETCH_DEFAULT_BATCH_SIZE).toInt());
+}
+
+void repo::gui::RepoWorkerFetchRevision::setBatchSize(int documentsCount)
+{
+    QSettings settings;
+    settings.setValue(REPO_SETTINGS_FETCH_BATCH_SIZE, documentsCount);
+}
+
+QByteArray repo::gui::RepoWorkerFetchRevision::getID(const mongo::BSONObj &obj)
+{
+    int length = 0;
+    const mongo::BSONElement element = obj.getField(REPO_NODE_LABEL_ID);
+    const char *bytes = element.isNull() ? NULL : element.binData(length);
+    return bytes ? QByteArray(bytes, length) : QByteArray();
 }
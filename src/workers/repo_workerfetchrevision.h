@@ -22,12 +22,19 @@
 #include "repo_worker_abstract.h"
 #include "../conversion/repo_transcoder_assimp.h"
 //-----------------------------------------------------------------------------
+#include <GLC_Camera>
+#include <GLC_World>
+//-----------------------------------------------------------------------------
 #include "assimpwrapper.h"
 #include "graph/repo_graph_scene.h"
 #include "mongoclientwrapper.h"
 #include "repocore.h"
 //-----------------------------------------------------------------------------
+#include <QHash>
 #include <QImage>
+#include <QMutex>
+//-----------------------------------------------------------------------------
+#include <functional>
 
 namespace repo {
 namespace gui {
@@ -37,6 +44,13 @@ class RepoWorkerFetchRevision : public RepoWorkerAbstract
 {
 	Q_OBJECT
 
+public :
+
+	static const QString REPO_SETTINGS_FETCH_BATCH_SIZE;
+
+	//! Default number of unique IDs queried at once.
+	static const int REPO_FETCH_DEFAULT_BATCH_SIZE = 2000;
+
 public :
 
 	/*! Takes a database path to a 3D file that is to be loaded
@@ -56,6 +70,12 @@ public :
 	//! Default empty destructor.
 	~RepoWorkerFetchRevision();
 
+	//! Returns the number of unique IDs queried at once.
+	static int getBatchSize();
+
+	//! Sets the number of unique IDs queried at once.
+	static void setBatchSize(int documentsCount);
+
 public slots :
 
 	/*! 
@@ -64,18 +84,137 @@ public slots :
 	 */
 	void run();
 
+	/*!
+	 * Sets the camera of the window the revision is streamed into, meshes
+	 * nearest to its eye are fetched first. Connect with Qt::DirectConnection.
+	 */
+	void setCamera(const GLC_Camera &camera);
+
 signals :
 
 	//! Emitted when loading is finished. Passes Repo scene and GLC world.
 	void finished(repo::core::RepoGraphScene*, GLC_World&);
 
+	/*!
+	 * Emitted after finished() for every texture decoded in the background
+	 * if connected, the scene is then first converted with placeholders.
+	 * Emitted from the decoding threads.
+	 */
+	void textureLoaded(const QString &name, const QImage &image);
+
+	/*!
+	 * Emitted while the revision is fetched in two phases if connected,
+	 * first with the bounding boxes of all the meshes and then with every
+	 * batch of meshes as their geometry arrives. Connect with
+	 * Qt::BlockingQueuedConnection as the chunk is only valid during the call.
+	 */
+	void chunkLoaded(GLC_World &);
+
 private :
 
-    core::RepoGraphScene *fetchSceneRecursively(const std::string &database,
-            const std::string &uuid,
-            bool isHeadRevision,
-            core::RepoGraphScene *masterSceneGraph,
-            core::RepoNodeReference *referenceNode);
+	/*!
+	 * Fetches the revision together with all the revisions it references
+	 * and returns the federated scene graph. Referenced revisions are
+	 * fetched level by level, each level in parallel over a small pool of
+	 * connections, and appended to the master graph in the order of their
+	 * references so that the result does not depend on timing.
+	 */
+	core::RepoGraphScene *fetchFederation(
+		const std::string &database,
+		const std::string &uuid,
+		bool isHeadRevision);
+
+	/*!
+	 * Fetches a single revision over the given connection and returns its
+	 * scene graph, NULL if cancelled. Reports progress per fetched document
+	 * if reportDocuments is true. Reentrant as long as each thread uses its
+	 * own connection.
+	 */
+	core::RepoGraphScene *fetchScene(
+		core::MongoClientWrapper &connection,
+		const std::string &database,
+		const std::string &uuid,
+		bool isHeadRevision,
+		bool reportDocuments);
+
+	/*!
+	 * Fetches a single revision in two phases and returns its complete scene
+	 * graph, NULL if cancelled. The first phase fetches all the documents
+	 * without geometry to build the transformation tree and streams the 
+	 * bounding boxes of the meshes. The second one fetches the geometry in
+	 * batches, nearest to the camera first, and streams each batch.
+	 */
+	core::RepoGraphScene *fetchSceneInTwoPhases(
+		core::MongoClientWrapper &connection,
+		const std::string &database,
+		const std::string &uuid,
+		bool isHeadRevision);
+
+	//! Returns the unique IDs of all the documents of the given revision.
+	mongo::BSONArray fetchRevisionIDs(
+		core::MongoClientWrapper &connection,
+		const std::string &database,
+		const std::string &uuid,
+		bool isHeadRevision);
+
+	/*!
+	 * Passes the scene documents of the given unique IDs one by one to
+	 * consume as they arrive. All the fields are fetched if the projection
+	 * is empty. Documents not in the document cache are queried in batches
+	 * of getBatchSize() IDs, several batches at once.
+	 */
+	void fetchDocuments(
+		core::MongoClientWrapper &connection,
+		const std::string &database,
+		const mongo::BSONArray &array,
+		const mongo::BSONObj &projection,
+		bool reportDocuments,
+		const std::function<void(const mongo::BSONObj &)> &consume);
+
+	//! Appends the scene documents of the given unique IDs to data.
+	void fetchDocuments(
+		core::MongoClientWrapper &connection,
+		const std::string &database,
+		const mongo::BSONArray &array,
+		const mongo::BSONObj &projection,
+		bool reportDocuments,
+		std::vector<mongo::BSONObj> &data);
+
+	/*!
+	 * Passes the scene documents of a single batch of unique IDs to consume,
+	 * re-querying the IDs that did not arrive if the cursor ends early.
+	 * Returns the number of documents still missing when giving up.
+	 */
+	int fetchBatch(
+		core::MongoClientWrapper &connection,
+		const std::string &database,
+		const mongo::BSONArray &ids,
+		const mongo::BSONObj &projection,
+		const std::function<void(const mongo::BSONObj &)> &consume);
+
+	/*!
+	 * Returns a cursor over the scene documents of the given unique IDs with
+	 * only the fields of the projection, all of them if empty.
+	 */
+	static std::auto_ptr<mongo::DBClientCursor> findByUniqueIDs(
+		core::MongoClientWrapper &connection,
+		const std::string &database,
+		const mongo::BSONArray &ids,
+		const mongo::BSONObj &projection);
+
+	//! Splits unique IDs into arrays of at most batchSize IDs each.
+	static std::vector<mongo::BSONArray> splitIDs(
+		const mongo::BSONArray &ids,
+		int batchSize);
+
+	//! Collects the absolute matrices of every mesh instance under the node.
+	static void getMeshInstances(
+		const core::RepoNodeAbstract *node,
+		const GLC_Matrix4x4 &parentMatrix,
+		QHash<const core::RepoNodeAbstract*, QList<GLC_Matrix4x4> > &instances);
+
+	//! Returns the unique ID of a document as bytes.
+	static QByteArray getID(const mongo::BSONObj &obj);
 
 	//! Client connection
 	repo::core::MongoClientWrapper mongo;
@@ -95,6 +234,30 @@ private :
     //! Number of jobs already done.
     int done;
 
+	//! Guards the progress counters updated from the fetching threads.
+	QMutex progressMutex;
+
+	//! Guards the viewpoint set from the GUI thread.
+	QMutex viewpointMutex;
+
+	//! Eye of the camera the meshes are sorted by.
+	GLC_Point3d viewpoint;
+
+	//! True once the viewpoint has been set.
+	bool hasViewpoint;
+
+	//! Maximum number of connections fetching referenced revisions at once.
+	static const int REPO_FETCH_CONNECTIONS_COUNT = 4;
+
+	//! Number of meshes fetched at once in the second phase.
+	static const int REPO_FETCH_MESHES_BATCH_SIZE = 64;
+
+	//! Maximum number of batches of documents fetched at once.
+	static const int REPO_FETCH_BATCHES_IN_FLIGHT = 4;
+
+	//! Number of fetched documents written to the document cache at once.
+	static const unsigned int REPO_DOCUMENT_CACHE_BATCH_SIZE = 256;
+
 }; // end class
 
 } // end namespace gui